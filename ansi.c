@@ -0,0 +1,321 @@
+/* 
+ * ansi.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <ncurses.h>
+#include "game.h"
+#include "render.h"
+/* */
+
+/* ANSI backend constants */
+#define ANSI_CELL_BYTES  16         /* worst case per cell: cursor move, character set switch and the character */
+#define ANSI_SLACK       256        /* room for the screen setup and the bell */
+#define ANSI_UNKNOWN     0xFFFF     /* shadow value of a cell whose content is not known */
+#define ANSI_GRAPHICS    0x100      /* shadow flag of the characters drawn from the line drawing set */
+#define ANSI_KEYS        32         /* bytes of input buffered while a key is decoded */
+/* */
+
+/* Global variables */
+int ansiOutput = STDOUT_FILENO;       /* descriptor the frames are written to */
+/* */
+
+/* Backend state, one frame is built in a buffer allocated once and written with a single write */
+static struct termios savedTerminal;  /* terminal settings to restore on stop */
+static bool rawTerminal = false;      /* the settings were changed */
+static char *frame;                   /* escape sequences of the frame being built */
+static size_t frameSize, frameCapacity;
+static uint16_t *shadow;              /* what the terminal shows on each cell of the board view */
+static int cursorRow, cursorCol;      /* where the cursor is, -1 when it is not known */
+static bool graphicsSet;              /* the line drawing character set is selected */
+static unsigned char keys[ANSI_KEYS]; /* input read but not decoded yet */
+static int keyCount;
+/* */
+
+/* Function prototypes for the internal helpers */
+static bool ansiStart(int width, int height);
+static void ansiStop();
+static void ansiClearScreen();
+static void ansiPutCell(int row, int col, Glyph glyph);
+static void ansiPutText(int row, int col, const char *text);
+static void ansiFinishFrame();
+static void ansiPresent();
+static void ansiOpenMenu();
+static void ansiMenuText(int row, int col, const char *text);
+static int ansiReadKey(bool wait);
+static void ansiAlert();
+static void appendBytes(const char *bytes, size_t count);
+static void appendString(const char *text);
+static void moveCursor(int row, int col);
+static void putCharacter(uint16_t code);
+static void forgetShadow(uint16_t code);
+static int decodeKey();
+/* */
+
+/* Raw ANSI backend */
+const Renderer ansiRenderer = {
+    "ansi", ansiStart, ansiStop, ansiClearScreen, ansiPutCell, ansiPutText, ansiFinishFrame,
+    ansiPresent, ansiOpenMenu, ansiMenuText, ansiReadKey, ansiAlert
+};
+/* */
+
+/* Function responsible of taking over the terminal: no echo, no line buffering, alternate screen, hidden cursor */
+static bool ansiStart(int width, int height) {
+    /* Ask the terminal for its size, like ncurses fall back on the environment and then on 24x80 */
+    struct winsize size;
+    int rows = 24, cols = 80;
+    if (ioctl(ansiOutput, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        cols = size.ws_col;
+    } else if (getenv("LINES") != NULL && getenv("COLUMNS") != NULL) {
+        rows = atoi(getenv("LINES"));
+        cols = atoi(getenv("COLUMNS"));
+    }
+    if (!layoutScreen(rows, cols, width, height)) return false;
+
+    /* Keys arrive one by one and reads never block, signals still work like with cbreak */
+    if (tcgetattr(STDIN_FILENO, &savedTerminal) == 0) {
+        struct termios raw = savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        rawTerminal = true;
+    }
+
+    /* Even a frame that changes every cell of the screen fits, nothing is allocated while playing */
+    frameCapacity = (size_t)rows * cols * ANSI_CELL_BYTES + ANSI_SLACK;
+    frame = malloc(frameCapacity);
+    frameSize = 0;
+    shadow = malloc((size_t)layout.viewRows * layout.viewCols * sizeof(uint16_t));
+    keyCount = 0;
+
+    appendString("\033[?1049h\033[?25l");
+    ansiClearScreen();
+    ansiPresent();
+    return true;
+}
+
+/* Function responsible of giving the terminal back as it was */
+static void ansiStop() {
+    appendString("\033(B\033[0m\033[?25h\033[?1049l");
+    ansiPresent();
+    if (rawTerminal) tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+    rawTerminal = false;
+
+    free(frame);
+    free(shadow);
+}
+
+/* Function responsible of blanking the screen, the board view is then known to be empty */
+static void ansiClearScreen() {
+    appendString("\033[2J");
+    cursorRow = cursorCol = -1;
+    forgetShadow(' ');
+}
+
+/* Function responsible of putting a glyph on the board, only when the terminal shows something else there */
+static void ansiPutCell(int row, int col, Glyph glyph) {
+    static const uint16_t codes[] = {
+        [GLYPH_EMPTY] = ' ',
+        [GLYPH_BODY] = SNAKE_BODY,
+        [GLYPH_RIVAL] = RIVAL_BODY,
+        [GLYPH_HEAD_UP] = SNAKE_HEAD_U,
+        [GLYPH_HEAD_DOWN] = SNAKE_HEAD_D,
+        [GLYPH_HEAD_LEFT] = SNAKE_HEAD_L,
+        [GLYPH_HEAD_RIGHT] = SNAKE_HEAD_R,
+        [GLYPH_FOOD] = FOOD,
+        [GLYPH_FOOD_TIMED] = FOOD_TIMED_ITEM,
+        [GLYPH_FOOD_BONUS] = FOOD_BONUS_ITEM,
+        [GLYPH_WALL_H] = ANSI_GRAPHICS | 'q',
+        [GLYPH_WALL_V] = ANSI_GRAPHICS | 'x',
+        [GLYPH_CORNER_UL] = ANSI_GRAPHICS | 'l',
+        [GLYPH_CORNER_UR] = ANSI_GRAPHICS | 'k',
+        [GLYPH_CORNER_LL] = ANSI_GRAPHICS | 'm',
+        [GLYPH_CORNER_LR] = ANSI_GRAPHICS | 'j',
+        [GLYPH_BLOCK] = ANSI_GRAPHICS | 'a'
+    };
+
+    uint16_t *shown = &shadow[row * layout.viewCols + col];
+    if (*shown == codes[glyph]) return;
+    *shown = codes[glyph];
+
+    moveCursor(layout.viewTop + row, layout.viewLeft + col);
+    putCharacter(codes[glyph]);
+}
+
+/* Function responsible of writing text on the board, cell by cell like the glyphs */
+static void ansiPutText(int row, int col, const char *text) {
+    for (; *text != '\0' && col < layout.viewCols; text++, col++) {
+        uint16_t *shown = &shadow[row * layout.viewCols + col];
+        if (*shown == (unsigned char)*text) continue;
+        *shown = (unsigned char)*text;
+
+        moveCursor(layout.viewTop + row, layout.viewLeft + col);
+        putCharacter((unsigned char)*text);
+    }
+}
+
+/* Function responsible of finishing the board, the frame is already in the buffer */
+static void ansiFinishFrame() {
+    /* Nothing to queue, the cells went into the frame buffer as they were drawn */
+}
+
+/* Function responsible of sending the frame to the terminal, one write unless the terminal takes it in pieces */
+static void ansiPresent() {
+    size_t written = 0;
+    while (written < frameSize) {
+        ssize_t count = write(ansiOutput, frame + written, frameSize - written);
+        if (count <= 0) break;
+        written += count;
+    }
+    frameSize = 0;
+}
+
+/* Function responsible of blanking the screen and drawing the menu box with the line drawing characters */
+static void ansiOpenMenu() {
+    int top = layout.menuTop, left = layout.menuLeft;
+
+    appendString("\033[2J");
+    cursorRow = cursorCol = -1;
+    for (int row = 0; row < SCREEN_HEIGHT; row++) {
+        bool edge = row == 0 || row == SCREEN_HEIGHT - 1;
+        moveCursor(top + row, left);
+        putCharacter(ANSI_GRAPHICS | (row == 0 ? 'l' : row == SCREEN_HEIGHT - 1 ? 'm' : 'x'));
+        if (edge) {
+            for (int col = 1; col < SCREEN_WIDTH - 1; col++) putCharacter(ANSI_GRAPHICS | 'q');
+        } else {
+            moveCursor(top + row, left + SCREEN_WIDTH - 1);
+        }
+        putCharacter(ANSI_GRAPHICS | (row == 0 ? 'k' : row == SCREEN_HEIGHT - 1 ? 'j' : 'x'));
+    }
+
+    /* The menu covers the board, its cells have to be sent again */
+    forgetShadow(ANSI_UNKNOWN);
+}
+
+/* Function responsible of writing text on the menu, tabs stop every 8 columns of the menu like in ncurses */
+static void ansiMenuText(int row, int col, const char *text) {
+    moveCursor(layout.menuTop + row, layout.menuLeft + col);
+    for (; *text != '\0' && col < SCREEN_WIDTH; text++) {
+        if (*text == '\t') {
+            col = (col / 8 + 1) * 8;
+            moveCursor(layout.menuTop + row, layout.menuLeft + col);
+            continue;
+        }
+        putCharacter((unsigned char)*text);
+        col++;
+    }
+}
+
+/* Function responsible of reading a key, the menu waits for one while the game only takes what is there */
+static int ansiReadKey(bool wait) {
+    for (;;) {
+        int key = decodeKey();
+        if (key != ERR) return key;
+
+        /* Wait for the rest of an escape sequence only when waiting anyway */
+        if (wait) {
+            struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+            poll(&input, 1, -1);
+        }
+        ssize_t count = read(STDIN_FILENO, keys + keyCount, ANSI_KEYS - keyCount);
+        if (count <= 0 && !wait) return ERR;
+        if (count > 0) keyCount += count;
+    }
+}
+
+/* Function responsible of ringing the terminal bell */
+static void ansiAlert() {
+    appendString("\a");
+    ansiPresent();
+}
+
+/* Function responsible of appending bytes to the frame, the buffer is sized for the worst frame */
+static void appendBytes(const char *bytes, size_t count) {
+    if (frameSize + count > frameCapacity) ansiPresent();
+    memcpy(frame + frameSize, bytes, count);
+    frameSize += count;
+}
+
+/* Function responsible of appending a string to the frame */
+static void appendString(const char *text) {
+    appendBytes(text, strlen(text));
+}
+
+/* Function responsible of moving the cursor, nothing is sent when it is already there */
+static void moveCursor(int row, int col) {
+    if (row == cursorRow && col == cursorCol) return;
+
+    char sequence[24];
+    int count = snprintf(sequence, sizeof(sequence), "\033[%d;%dH", row + 1, col + 1);
+    appendBytes(sequence, count);
+    cursorRow = row;
+    cursorCol = col;
+}
+
+/* Function responsible of writing one character, switching the character set only when it changes */
+static void putCharacter(uint16_t code) {
+    bool graphics = code & ANSI_GRAPHICS;
+    if (graphics != graphicsSet) {
+        appendString(graphics ? "\033(0" : "\033(B");
+        graphicsSet = graphics;
+    }
+
+    char ch = code & 0xFF;
+    appendBytes(&ch, 1);
+
+    /* The cursor stays on the last column after writing there, where it is depends on the terminal */
+    if (++cursorCol >= layout.terminalCols) cursorRow = cursorCol = -1;
+}
+
+/* Function responsible of setting every cell of the board view to the same known or unknown content */
+static void forgetShadow(uint16_t code) {
+    for (int i = 0; i < layout.viewRows * layout.viewCols; i++) shadow[i] = code;
+}
+
+/* Function responsible of decoding the next key from the buffered input, ERR when there is no whole key */
+static int decodeKey() {
+    if (keyCount == 0) return ERR;
+
+    int key = keys[0], used = 1;
+    if (keys[0] == '\033') {
+        /* Arrows come as ESC [ A or, in application mode, ESC O A */
+        if (keyCount < 3 && (keyCount == 1 || keys[1] == '[' || keys[1] == 'O')) return ERR;
+        if ((keys[1] == '[' || keys[1] == 'O') && keys[2] >= 'A' && keys[2] <= 'D') {
+            static const int arrows[] = { KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT };
+            key = arrows[keys[2] - 'A'];
+            used = 3;
+        }
+    }
+
+    keyCount -= used;
+    memmove(keys, keys + used, keyCount);
+    return key;
+}
@@ -0,0 +1,525 @@
+/* 
+ * arena.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "game.h"
+#include "rng.h"
+#include "stats.h"
+#include "arena.h"
+/* */
+
+/* Movement of each direction, indexed by Direction */
+static const int moveX[] = { 0, 0, -1, 1 };
+static const int moveY[] = { -1, 1, 0, 0 };
+static const Direction opposite[] = { DOWN, UP, RIGHT, LEFT };
+/* */
+
+/* Function prototypes for the internal helpers */
+static void *arenaWorkerMain(void *arg);
+static void arenaBarrier(Arena *arena, bool *sense);
+static void stepSlice(ArenaWorker *worker);
+static void planMoves(ArenaWorker *worker);
+static void resolveBand(ArenaWorker *worker);
+static void releaseCells(ArenaWorker *worker);
+static void takeCells(ArenaWorker *worker);
+static void finishTick(Arena *arena);
+static Direction botDirection(const Arena *arena, ArenaSnake *snake);
+static bool spawnSnake(Arena *arena, uint32_t index);
+static void placeArenaApple(Arena *arena, uint32_t apple);
+static uint32_t arenaFreeCell(Arena *arena);
+static void growRing(ArenaSnake *snake);
+/* */
+
+/* Cell helpers */
+static inline uint32_t positionCell(const Arena *arena, Position position) {
+    return (uint32_t)position.pY * arena->width + position.pX;
+}
+
+static inline uint32_t tailCell(const Arena *arena, const ArenaSnake *snake) {
+    uint32_t tail = snake->head + snake->length - 1;
+    if (tail >= snake->capacity) tail -= snake->capacity;
+    return positionCell(arena, snake->body[tail]);
+}
+/* */
+
+/* Function responsible of allocating an arena with its snakes and apples, and starting its workers */
+Arena *startArena(uint32_t count, uint32_t players, uint64_t seed, int width, int height, unsigned int workers) {
+    Arena *arena = calloc(1, sizeof(Arena));
+    size_t cells = (size_t)width * height;
+
+    arena->width = width;
+    arena->height = height;
+    arena->owner = calloc(cells, sizeof(SnakeId));
+    arena->count = count;
+    arena->players = players;
+    arena->snakes = calloc(count, sizeof(ArenaSnake));
+    arena->appleCount = count / ARENA_SNAKES_PER_APPLE + 1;
+    arena->apples = malloc(arena->appleCount * sizeof(uint32_t));
+    seedRng(&arena->rng, seed, 0);
+
+    /* Wall off the border, only the border cells are visited */
+    for (int x = 0; x < width; x++) {
+        arena->owner[x] = ARENA_WALL;
+        arena->owner[(size_t)(height - 1) * width + x] = ARENA_WALL;
+    }
+    for (int y = 0; y < height; y++) {
+        arena->owner[(size_t)y * width] = ARENA_WALL;
+        arena->owner[(size_t)y * width + width - 1] = ARENA_WALL;
+    }
+
+    /* Apples first so the bots have something to chase, then the snakes, each bot with its own stream */
+    for (uint32_t a = 0; a < arena->appleCount; a++) placeArenaApple(arena, a);
+    for (uint32_t i = 0; i < count; i++) {
+        ArenaSnake *snake = &arena->snakes[i];
+        snake->capacity = START_SNAKE_SIZE * 4;
+        snake->body = malloc(snake->capacity * sizeof(Position));
+        snake->player = i < players;
+        snake->turn = INPUT_NONE;
+        seedRng(&snake->rng, seed, i + 1);
+        spawnSnake(arena, i);
+    }
+
+    /* Every worker steps a slice of the snakes and resolves the heads going into its band of rows */
+    if (workers < 1) workers = 1;
+    if (workers > ARENA_MAX_WORKERS) workers = ARENA_MAX_WORKERS;
+    arena->workers = workers;
+    arena->bandRows = (height + workers - 1) / workers;
+    arena->pool = calloc(workers, sizeof(ArenaWorker));
+    uint32_t claimSlots = 1;
+    while (claimSlots < 2 * count) claimSlots <<= 1;
+    for (unsigned int w = 0; w < workers; w++) {
+        ArenaWorker *worker = &arena->pool[w];
+        worker->arena = arena;
+        worker->id = w;
+        worker->first = (uint64_t)count * w / workers;
+        worker->last = (uint64_t)count * (w + 1) / workers;
+        worker->moves = malloc((size_t)workers * (worker->last - worker->first + 1) * sizeof(uint32_t));
+        worker->moveCounts = calloc(workers, sizeof(uint32_t));
+        worker->claims = calloc(claimSlots, sizeof(Claim));
+        worker->claimMask = claimSlots - 1;
+    }
+    atomic_init(&arena->arrived, 0);
+    atomic_init(&arena->release, false);
+
+    /* The calling thread is worker 0 */
+    for (unsigned int w = 1; w < workers; w++) {
+        pthread_create(&arena->pool[w].thread, NULL, arenaWorkerMain, &arena->pool[w]);
+    }
+
+    return arena;
+}
+
+/* Function responsible of turning a player's snake on its next move, the last turn asked before the tick wins */
+void steerArena(Arena *arena, uint32_t snake, Input input) {
+    if (input >= INPUT_UP && input <= INPUT_RIGHT) arena->snakes[snake].turn = input;
+}
+
+/* Function responsible of advancing every snake of the arena by one tick.
+ * Moves are planned per slice of snakes, conflicts are resolved per band of rows on the ownership grid,
+ * then tails leave and heads arrive, so the outcome does not depend on the number of workers */
+void stepArena(Arena *arena) {
+    ArenaWorker *worker = &arena->pool[0];
+
+    /* Let the helper threads into the tick */
+    arenaBarrier(arena, &worker->sense);
+    stepSlice(worker);
+    finishTick(arena);
+}
+
+/* Function returning the head of a snake */
+const Position *arenaHead(const Arena *arena, uint32_t snake) {
+    const ArenaSnake *s = &arena->snakes[snake];
+    return &s->body[s->head];
+}
+
+/* Function responsible of computing the score of a snake, counting the segments it is still growing */
+int arenaScore(const Arena *arena, uint32_t snake) {
+    const ArenaSnake *s = &arena->snakes[snake];
+    return (int)(s->length + s->growth) - START_SNAKE_SIZE;
+}
+
+/* Function responsible of stopping the workers and freeing an arena */
+void freeArena(Arena *arena) {
+    /* The helper threads see the flag when they are let into the next tick */
+    arena->stopping = true;
+    arenaBarrier(arena, &arena->pool[0].sense);
+    for (unsigned int w = 1; w < arena->workers; w++) pthread_join(arena->pool[w].thread, NULL);
+
+    for (unsigned int w = 0; w < arena->workers; w++) {
+        free(arena->pool[w].moves);
+        free(arena->pool[w].moveCounts);
+        free(arena->pool[w].claims);
+    }
+    for (uint32_t i = 0; i < arena->count; i++) free(arena->snakes[i].body);
+    free(arena->pool);
+    free(arena->snakes);
+    free(arena->apples);
+    free(arena->owner);
+    free(arena);
+}
+
+/* Function responsible of stepping a crowd of bots without a terminal and printing the tick times */
+void runArena(uint32_t count, unsigned long ticks, unsigned int workers, uint64_t seed, int width, int height,
+              FILE *out) {
+    struct timespec start, end, before, after;
+    Histogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+
+    Arena *arena = startArena(count, 0, seed, width, height, workers);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned long tick = 0; tick < ticks; tick++) {
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        stepArena(arena);
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        histogramAdd(&histogram, (after.tv_sec - before.tv_sec) * 1000000000LL + (after.tv_nsec - before.tv_nsec));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint32_t alive = 0, longest = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        alive += arena->snakes[i].alive;
+        if (arena->snakes[i].best > longest) longest = arena->snakes[i].best;
+    }
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(out, "Arena: %u snakes on %dx%d, %u workers, %lu ticks in %.3f s: %.0f ticks/sec\n",
+            count, width, height, arena->workers, ticks, elapsed, ticks / elapsed);
+    fprintf(out, "Tick: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            histogram.count ? (double)histogram.sum / histogram.count / 1e3 : 0.0,
+            histogramPercentile(&histogram, 0.50) / 1e3, histogramPercentile(&histogram, 0.99) / 1e3,
+            histogram.max / 1e3);
+    fprintf(out, "Deaths: %lu (%lu head-on), %u alive at the end, longest snake %u (seed %llu)\n",
+            arena->deaths, arena->headOns, alive, longest, (unsigned long long)seed);
+
+    freeArena(arena);
+}
+
+/* Function run by every helper thread: step its slice and band whenever a tick starts */
+static void *arenaWorkerMain(void *arg) {
+    ArenaWorker *worker = arg;
+    Arena *arena = worker->arena;
+
+    for (;;) {
+        arenaBarrier(arena, &worker->sense);
+        if (arena->stopping) break;
+        stepSlice(worker);
+    }
+
+    return NULL;
+}
+
+/* Function responsible of waiting until every worker reached the same point, spinning as phases are short */
+static void arenaBarrier(Arena *arena, bool *sense) {
+    *sense = !*sense;
+    if (atomic_fetch_add_explicit(&arena->arrived, 1, memory_order_acq_rel) == arena->workers - 1) {
+        /* Last one in, reset the count and let the others go */
+        atomic_store_explicit(&arena->arrived, 0, memory_order_relaxed);
+        atomic_store_explicit(&arena->release, *sense, memory_order_release);
+        return;
+    }
+
+    /* Give the core away after a short spin, in case there are more workers than cores */
+    for (unsigned int spins = 0; atomic_load_explicit(&arena->release, memory_order_acquire) != *sense; spins++) {
+        if (spins >= 64) sched_yield();
+    }
+}
+
+/* Function responsible of the parallel part of a tick, each phase reads what the previous one wrote */
+static void stepSlice(ArenaWorker *worker) {
+    Arena *arena = worker->arena;
+
+    planMoves(worker);
+    arenaBarrier(arena, &worker->sense);
+    resolveBand(worker);
+    arenaBarrier(arena, &worker->sense);
+    releaseCells(worker);
+    arenaBarrier(arena, &worker->sense);
+    takeCells(worker);
+    arenaBarrier(arena, &worker->sense);
+}
+
+/* Function responsible of choosing where every snake of the slice moves and handing the move to its band */
+static void planMoves(ArenaWorker *worker) {
+    Arena *arena = worker->arena;
+    uint32_t slice = worker->last - worker->first + 1;
+    memset(worker->moveCounts, 0, arena->workers * sizeof(uint32_t));
+
+    for (uint32_t i = worker->first; i < worker->last; i++) {
+        ArenaSnake *snake = &arena->snakes[i];
+        snake->next = -1;
+        snake->eats = false;
+        snake->vacates = false;
+        snake->dies = false;
+        if (!snake->alive) continue;
+
+        /* Players turn like in the single game, bots find their own way */
+        if (snake->player) {
+            Direction turn = (Direction)(snake->turn - INPUT_UP);
+            if (snake->turn != INPUT_NONE && turn != opposite[snake->direction]) snake->direction = turn;
+            snake->turn = INPUT_NONE;
+        } else {
+            snake->direction = botDirection(arena, snake);
+        }
+
+        /* Alive heads are never on the border, so the next cell is always on the board */
+        const Position *head = &snake->body[snake->head];
+        int x = head->pX + moveX[snake->direction];
+        int y = head->pY + moveY[snake->direction];
+        snake->next = (int32_t)((uint32_t)y * arena->width + x);
+        snake->eats = arena->owner[snake->next] == ARENA_APPLE;
+        snake->vacates = !snake->eats && snake->growth == 0;
+
+        uint32_t band = y / arena->bandRows;
+        worker->moves[band * slice + worker->moveCounts[band]++] = i;
+    }
+}
+
+/* Function responsible of deciding which heads going into this worker's band survive.
+ * Only the grid as it was before the tick is read, a tail leaving on this tick does not block,
+ * and heads meeting on a cell all die, so the order the heads are looked at does not matter */
+static void resolveBand(ArenaWorker *worker) {
+    Arena *arena = worker->arena;
+    uint32_t stamp = (uint32_t)(arena->ticks % UINT32_MAX) + 1;
+
+    for (unsigned int w = 0; w < arena->workers; w++) {
+        const ArenaWorker *from = &arena->pool[w];
+        const uint32_t *moves = from->moves + worker->id * (from->last - from->first + 1);
+
+        for (uint32_t m = 0; m < from->moveCounts[worker->id]; m++) {
+            ArenaSnake *snake = &arena->snakes[moves[m]];
+            uint32_t cell = snake->next;
+            SnakeId owner = arena->owner[cell];
+
+            if (owner == ARENA_WALL) {
+                snake->dies = true;
+            } else if (owner != ARENA_EMPTY && owner != ARENA_APPLE) {
+                const ArenaSnake *other = &arena->snakes[owner - 1];
+                snake->dies = !other->vacates || tailCell(arena, other) != cell;
+            }
+
+            /* Claims of older ticks are empty slots, so the table never needs clearing */
+            uint32_t slot = cell * 0x9E3779B1u & worker->claimMask;
+            while (worker->claims[slot].stamp == stamp && worker->claims[slot].cell != cell) {
+                slot = (slot + 1) & worker->claimMask;
+            }
+            Claim *claim = &worker->claims[slot];
+            if (claim->stamp == stamp) {
+                snake->dies = true;
+                arena->snakes[claim->snake].dies = true;
+                worker->headOns++;
+            } else {
+                claim->cell = cell;
+                claim->stamp = stamp;
+                claim->snake = moves[m];
+            }
+        }
+    }
+}
+
+/* Function responsible of taking the dead snakes and the leaving tails of the slice off the grid */
+static void releaseCells(ArenaWorker *worker) {
+    Arena *arena = worker->arena;
+
+    for (uint32_t i = worker->first; i < worker->last; i++) {
+        ArenaSnake *snake = &arena->snakes[i];
+        if (snake->next < 0) continue;
+
+        if (snake->dies) {
+            /* The whole body leaves, its cells are free from the next tick on */
+            uint32_t index = snake->head;
+            for (uint32_t k = 0; k < snake->length; k++) {
+                arena->owner[positionCell(arena, snake->body[index])] = ARENA_EMPTY;
+                if (++index == snake->capacity) index = 0;
+            }
+            snake->alive = false;
+            snake->respawn = ARENA_RESPAWN;
+            worker->deaths++;
+        } else if (snake->vacates) {
+            arena->owner[tailCell(arena, snake)] = ARENA_EMPTY;
+            snake->length--;
+        } else if (!snake->eats) {
+            snake->growth--;
+        }
+    }
+}
+
+/* Function responsible of moving the surviving heads of the slice, no two of them share a cell */
+static void takeCells(ArenaWorker *worker) {
+    Arena *arena = worker->arena;
+
+    for (uint32_t i = worker->first; i < worker->last; i++) {
+        ArenaSnake *snake = &arena->snakes[i];
+        if (snake->next < 0 || snake->dies) continue;
+
+        if (snake->length == snake->capacity) growRing(snake);
+        snake->head = (snake->head == 0 ? snake->capacity : snake->head) - 1;
+        snake->body[snake->head].pX = snake->next % arena->width;
+        snake->body[snake->head].pY = snake->next / arena->width;
+        snake->length++;
+        arena->owner[snake->next] = i + 1;
+
+        /* Like the single game, an apple grows the snake by the new head now and one more segment later */
+        if (snake->eats) snake->growth++;
+        if (snake->length > snake->best) snake->best = snake->length;
+    }
+}
+
+/* Function responsible of the serial end of a tick: counters, eaten apples and dead bots */
+static void finishTick(Arena *arena) {
+    for (unsigned int w = 0; w < arena->workers; w++) {
+        arena->deaths += arena->pool[w].deaths;
+        arena->headOns += arena->pool[w].headOns;
+        arena->pool[w].deaths = 0;
+        arena->pool[w].headOns = 0;
+    }
+
+    /* Eaten apples, and the ones that found no room before, come back on a free cell */
+    for (uint32_t a = 0; a < arena->appleCount; a++) {
+        if (arena->apples[a] == ARENA_NOWHERE || arena->owner[arena->apples[a]] != ARENA_APPLE) {
+            placeArenaApple(arena, a);
+        }
+    }
+
+    /* Dead bots come back after a while, players stay dead */
+    for (uint32_t i = 0; i < arena->count; i++) {
+        ArenaSnake *snake = &arena->snakes[i];
+        if (snake->alive || snake->player) continue;
+        if (snake->respawn > 0) snake->respawn--;
+        if (snake->respawn == 0) spawnSnake(arena, i);
+    }
+
+    arena->ticks++;
+}
+
+/* Function responsible of picking a bot's move: towards its apple, away from anything it would run into */
+static Direction botDirection(const Arena *arena, ArenaSnake *snake) {
+    const Position *head = &snake->body[snake->head];
+    int width = arena->width;
+
+    /* Once the chased apple was eaten, chase the nearest of a few random ones */
+    if (snake->targetCell == ARENA_NOWHERE || arena->apples[snake->target] != snake->targetCell) {
+        int bestDistance = INT32_MAX;
+        snake->targetCell = ARENA_NOWHERE;
+        for (int s = 0; s < ARENA_SAMPLES; s++) {
+            uint32_t apple = boundedRng(&snake->rng, arena->appleCount);
+            uint32_t cell = arena->apples[apple];
+            if (cell == ARENA_NOWHERE) continue;
+
+            int distance = abs((int)(cell % width) - head->pX) + abs((int)(cell / width) - head->pY);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                snake->target = apple;
+                snake->targetCell = cell;
+            }
+        }
+    }
+    int targetX = snake->targetCell == ARENA_NOWHERE ? head->pX : (int)(snake->targetCell % width);
+    int targetY = snake->targetCell == ARENA_NOWHERE ? head->pY : (int)(snake->targetCell / width);
+
+    /* Same scoring as the single game's bot, on the ownership grid */
+    int bestScore = -(1 << 30);
+    Direction best = snake->direction;
+    for (int d = UP; d <= RIGHT; d++) {
+        if (d == (int)opposite[snake->direction]) continue;
+
+        int x = head->pX + moveX[d], y = head->pY + moveY[d];
+        SnakeId owner = arena->owner[(size_t)y * width + x];
+        if (owner != ARENA_EMPTY && owner != ARENA_APPLE) continue;
+
+        int room = 0;
+        for (int n = UP; n <= RIGHT; n++) {
+            SnakeId next = arena->owner[(size_t)(y + moveY[n]) * width + x + moveX[n]];
+            room += next == ARENA_EMPTY || next == ARENA_APPLE;
+        }
+        int score = -(abs(targetX - x) + abs(targetY - y)) * 4 + room;
+        if (room == 0) score -= 1 << 20;
+
+        if (score > bestScore) {
+            bestScore = score;
+            best = d;
+        }
+    }
+
+    return best;
+}
+
+/* Function responsible of putting a snake back on a free cell, it starts as a head and grows to the usual size */
+static bool spawnSnake(Arena *arena, uint32_t index) {
+    ArenaSnake *snake = &arena->snakes[index];
+    uint32_t cell = arenaFreeCell(arena);
+    if (cell == ARENA_NOWHERE) return false;
+
+    snake->head = 0;
+    snake->length = 1;
+    snake->growth = START_SNAKE_SIZE - 1;
+    snake->body[0].pX = cell % arena->width;
+    snake->body[0].pY = cell / arena->width;
+    snake->direction = boundedRng(&arena->rng, 4);
+    snake->alive = true;
+    snake->respawn = 0;
+    snake->targetCell = ARENA_NOWHERE;
+    if (snake->best == 0) snake->best = 1;
+    arena->owner[cell] = index + 1;
+    return true;
+}
+
+/* Function responsible of moving an apple to a free cell, it waits for the next tick when none was found */
+static void placeArenaApple(Arena *arena, uint32_t apple) {
+    uint32_t cell = arenaFreeCell(arena);
+    arena->apples[apple] = cell;
+    if (cell != ARENA_NOWHERE) arena->owner[cell] = ARENA_APPLE;
+}
+
+/* Function returning a random free cell, or ARENA_NOWHERE after a few misses on a crowded board */
+static uint32_t arenaFreeCell(Arena *arena) {
+    uint32_t cells = (uint32_t)arena->width * arena->height;
+
+    for (int tries = 0; tries < APPLE_TRIES; tries++) {
+        uint32_t cell = boundedRng(&arena->rng, cells);
+        if (arena->owner[cell] == ARENA_EMPTY) return cell;
+    }
+
+    return ARENA_NOWHERE;
+}
+
+/* Function responsible of doubling a snake's ring buffer, unrolled so the head is first again */
+static void growRing(ArenaSnake *snake) {
+    Position *body = malloc(2 * snake->capacity * sizeof(Position));
+    uint32_t first = snake->capacity - snake->head;
+    if (first > snake->length) first = snake->length;
+    memcpy(body, &snake->body[snake->head], first * sizeof(Position));
+    memcpy(body + first, snake->body, (snake->length - first) * sizeof(Position));
+
+    free(snake->body);
+    snake->body = body;
+    snake->head = 0;
+    snake->capacity *= 2;
+}
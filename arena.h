@@ -0,0 +1,100 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "game.h"
+#include "rng.h"
+
+/* Arena constants */
+#define ARENA_EMPTY      0          /* owner of a free cell */
+#define ARENA_APPLE      0xFFFE     /* owner of a cell holding an apple */
+#define ARENA_WALL       0xFFFF     /* owner of a border cell */
+#define ARENA_NOWHERE    UINT32_MAX /* cell of an apple that found no free cell yet */
+#define ARENA_MAX_SNAKES 65000      /* snake ids have to fit the owner grid below the apple and the wall */
+#define ARENA_CELLS_PER_SNAKE 16    /* free cells asked for each snake, so spawning does not crowd the board */
+#define ARENA_SNAKES_PER_APPLE 2    /* apples kept on the board, one for this many snakes */
+#define ARENA_RESPAWN    16         /* ticks a dead bot waits before coming back */
+#define ARENA_SAMPLES    4          /* apples a bot looks at when it picks the one to chase */
+#define ARENA_MAX_WORKERS 64        /* threads stepping an arena, each also owns a band of rows */
+#define ARENA_TICKS      10000      /* default number of ticks simulated by --arena with --headless */
+/* */
+
+/* Snake id as stored in the ownership grid, snake i of the arena is id i + 1 */
+typedef uint16_t SnakeId;
+
+/* Arena snake structure, a snake with its own ring buffer and the bookkeeping of the tick being stepped */
+typedef struct ArenaSnake {
+    Position *body;                 /* ring buffer, the head at index head, grown when the snake fills it */
+    uint32_t head, length, capacity;
+    uint32_t growth;                /* moves left that leave the tail in place */
+    Direction direction;
+    Input turn;                     /* turn asked by a player, applied on the next tick */
+    bool alive;
+    bool player;                    /* steered with steerArena instead of by the bot */
+    uint32_t respawn;               /* ticks left before a dead bot comes back */
+    uint32_t target;                /* apple chased by the bot */
+    uint32_t targetCell;            /* where that apple was when it was picked */
+    uint32_t best;                  /* longest length reached */
+    Rng rng;                        /* the bot's own stream, so its moves do not depend on the workers */
+    int32_t next;                   /* cell the head moves to on this tick, -1 when it does not move */
+    bool eats;                      /* the move reaches an apple */
+    bool vacates;                   /* the tail leaves its cell on this tick */
+    bool dies;                      /* the move runs into a wall, a body or another head */
+} ArenaSnake;
+
+/* Claim structure, a head moving into a cell on a given tick */
+typedef struct Claim {
+    uint32_t cell;
+    uint32_t stamp;                 /* tick of the claim plus one, older stamps are empty slots */
+    SnakeId snake;                  /* index of the claiming snake */
+} Claim;
+
+/* Arena worker structure, a thread with its slice of the snakes and its band of the board */
+typedef struct ArenaWorker {
+    pthread_t thread;
+    struct Arena *arena;
+    unsigned int id;
+    uint32_t first, last;           /* snakes stepped by this worker */
+    uint32_t *moves;                /* this worker's heads going into each band, a list of up to last - first per band */
+    uint32_t *moveCounts;           /* entries in each of those lists */
+    Claim *claims;                  /* cells claimed in this worker's band, open addressing with linear probing */
+    uint32_t claimMask;
+    bool sense;                     /* barrier phase this worker waits for */
+    unsigned long deaths, headOns;
+} ArenaWorker;
+
+/* Arena structure, many snakes on one board resolved through a single ownership grid */
+typedef struct Arena {
+    int width, height;
+    SnakeId *owner;                 /* snake id, ARENA_APPLE, ARENA_WALL or ARENA_EMPTY for every cell */
+    uint32_t count;                 /* snakes, the first players ones are the players */
+    uint32_t players;
+    ArenaSnake *snakes;
+    uint32_t appleCount;
+    uint32_t *apples;               /* cell of every apple */
+    Rng rng;                        /* apple and respawn placement */
+    unsigned long ticks;
+    unsigned long deaths, headOns;
+    unsigned int workers;
+    int bandRows;                   /* rows of the board in each worker's band */
+    ArenaWorker *pool;
+    _Atomic unsigned int arrived;   /* workers waiting at the barrier */
+    _Atomic bool release;           /* flipped by the last worker to reach the barrier */
+    bool stopping;                  /* the helper threads leave at the next tick */
+} Arena;
+
+/* Function prototypes */
+Arena *startArena(uint32_t count, uint32_t players, uint64_t seed, int width, int height, unsigned int workers);
+void steerArena(Arena *arena, uint32_t snake, Input input);
+void stepArena(Arena *arena);
+const Position *arenaHead(const Arena *arena, uint32_t snake);
+int arenaScore(const Arena *arena, uint32_t snake);
+void freeArena(Arena *arena);
+void runArena(uint32_t count, unsigned long ticks, unsigned int workers, uint64_t seed, int width, int height,
+              FILE *out);
+/* */
+
+#endif //ARENA_H
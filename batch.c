@@ -0,0 +1,255 @@
+/* 
+ * batch.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include <time.h>
+#include "game.h"
+#include "level.h"
+#include "bot.h"
+#include "scores.h"
+#include "batch.h"
+/* */
+
+/* Queue of games owned by a worker: a range of game numbers packed in a single word,
+ * the owner takes from the front and thieves take the back half, both with a CAS */
+typedef struct WorkQueue {
+    alignas(64) _Atomic uint64_t range;    /* next game in the low half, end of the range in the high half */
+} WorkQueue;
+
+/* Worker structure, everything a worker touches while playing */
+typedef struct Worker {
+    pthread_t thread;
+    unsigned int id;
+    unsigned int count;             /* number of workers, to find victims */
+    uint64_t seed;                  /* base seed, game i is played with stream i of it */
+    int width, height;              /* board size of every game */
+    const Level *level;             /* level every game is played on, NULL for the empty box */
+    WorkQueue *queues;              /* every worker's queue */
+    unsigned long games;            /* games played */
+    unsigned long long ticks;       /* ticks simulated */
+    unsigned long steals;           /* successful steals */
+    unsigned long *scores;          /* games per final score */
+    ScoreStore *store;              /* where finished games are recorded, NULL to skip */
+    ScoreRecord *pending;           /* records not handed to the store yet */
+    size_t pendingCount;
+} Worker;
+/* */
+
+/* Function prototypes for the internal helpers */
+static void *workerMain(void *arg);
+static bool takeGame(WorkQueue *queue, uint32_t *game);
+static bool stealGames(WorkQueue *victim, WorkQueue *self);
+static unsigned long scorePercentile(const unsigned long *scores, unsigned int maxScore, unsigned long games, double p);
+/* */
+
+/* Range packing helpers */
+static inline uint64_t packRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t)end << 32) | begin;
+}
+/* */
+
+/* Function responsible of playing a batch of games over a pool of work-stealing workers */
+void runBatch(unsigned long games, unsigned int workers, uint64_t seed, int width, int height, const Level *level,
+              ScoreStore *store, FILE *out) {
+    struct timespec start, end;
+    unsigned int maxScore = (unsigned int)width * height;
+
+    if (workers < 1) workers = 1;
+    WorkQueue *queues = aligned_alloc(64, workers * sizeof(WorkQueue));
+    Worker *pool = calloc(workers, sizeof(Worker));
+
+    /* Hand each worker an equal slice of the games, stealing evens out whatever is uneven */
+    for (unsigned int i = 0; i < workers; i++) {
+        uint32_t begin = games * i / workers;
+        uint32_t finish = games * (i + 1) / workers;
+        atomic_init(&queues[i].range, packRange(begin, finish));
+
+        pool[i].id = i;
+        pool[i].count = workers;
+        pool[i].seed = seed;
+        pool[i].width = width;
+        pool[i].height = height;
+        pool[i].level = level;
+        pool[i].queues = queues;
+        pool[i].scores = calloc(maxScore + 1, sizeof(unsigned long));
+        pool[i].store = store;
+        if (store != NULL) pool[i].pending = malloc(SCORES_BATCH * sizeof(ScoreRecord));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int i = 0; i < workers; i++) {
+        pthread_create(&pool[i].thread, NULL, workerMain, &pool[i]);
+    }
+    for (unsigned int i = 0; i < workers; i++) {
+        pthread_join(pool[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Merge the results of every worker */
+    unsigned long played = 0, steals = 0;
+    unsigned long long ticks = 0, totalScore = 0;
+    for (unsigned int i = 0; i < workers; i++) {
+        played += pool[i].games;
+        ticks += pool[i].ticks;
+        steals += pool[i].steals;
+        if (i > 0) {
+            for (unsigned int s = 0; s <= maxScore; s++) pool[0].scores[s] += pool[i].scores[s];
+        }
+    }
+    unsigned long *scores = pool[0].scores;
+    for (unsigned int s = 0; s <= maxScore; s++) totalScore += (unsigned long long)s * scores[s];
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(out, "Played %lu games on %u workers in %.3f s (%lu steals)\n", played, workers, elapsed, steals);
+    fprintf(out, "Throughput: %.0f games/sec, %.0f ticks/sec\n", played / elapsed, ticks / elapsed);
+    fprintf(out, "Score: mean %.1f, min %lu, p10 %lu, p50 %lu, p90 %lu, p99 %lu, max %lu\n",
+            played ? (double)totalScore / played : 0.0,
+            scorePercentile(scores, maxScore, played, 0.0), scorePercentile(scores, maxScore, played, 0.10),
+            scorePercentile(scores, maxScore, played, 0.50), scorePercentile(scores, maxScore, played, 0.90),
+            scorePercentile(scores, maxScore, played, 0.99), scorePercentile(scores, maxScore, played, 1.0));
+
+    /* Print the distribution in buckets of ten points */
+    fprintf(out, "Distribution:\n");
+    for (unsigned int s = 0; s <= maxScore; s += 10) {
+        unsigned long bucket = 0;
+        for (unsigned int i = s; i < s + 10 && i <= maxScore; i++) bucket += scores[i];
+        if (bucket > 0) fprintf(out, "  %4u-%-4u %lu\n", s, s + 9, bucket);
+    }
+
+    for (unsigned int i = 0; i < workers; i++) {
+        free(pool[i].scores);
+        free(pool[i].pending);
+    }
+    free(pool);
+    free(queues);
+}
+
+/* Function run by every worker: play its own games, then steal from the others until all are done */
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    WorkQueue *self = &worker->queues[worker->id];
+    unsigned long starvation = (unsigned long)worker->width * worker->height * BATCH_STARVATION;
+    GameState *state = startGame(worker->width, worker->height, worker->seed);
+    setLevel(state, worker->level);
+    struct timespec gameStart, gameEnd;
+    uint32_t game;
+
+    for (;;) {
+        if (!takeGame(self, &game)) {
+            /* Out of work, look for a victim starting with the next worker */
+            bool stole = false;
+            for (unsigned int i = 1; i < worker->count && !stole; i++) {
+                stole = stealGames(&worker->queues[(worker->id + i) % worker->count], self);
+            }
+            if (!stole) break;
+            worker->steals++;
+            continue;
+        }
+
+        /* Each game gets its own stream, so results do not depend on which worker played it */
+        seedGame(state, worker->seed, game);
+        resetGame(state);
+        if (worker->store != NULL) clock_gettime(CLOCK_MONOTONIC, &gameStart);
+
+        /* Play until death, win, or the bot went too long without eating */
+        unsigned long lastMeal = 0;
+        int score = gameScore(state);
+        while (state->isAlive && state->ticks - lastMeal < starvation) {
+            stepGame(state, greedyInput(state));
+            if (gameScore(state) != score) {
+                score = gameScore(state);
+                lastMeal = state->ticks;
+            }
+        }
+
+        worker->games++;
+        worker->ticks += state->ticks;
+        worker->scores[score < 0 ? 0 : score]++;
+
+        /* Records go to the store a block at a time, one lock for many games */
+        if (worker->store != NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &gameEnd);
+            makeScore(&worker->pending[worker->pendingCount++], state, worker->seed, game, PLAYER_BOT,
+                      (gameEnd.tv_sec - gameStart.tv_sec) * 1000 + (gameEnd.tv_nsec - gameStart.tv_nsec) / 1000000);
+            if (worker->pendingCount == SCORES_BATCH) {
+                addScores(worker->store, worker->pending, worker->pendingCount);
+                worker->pendingCount = 0;
+            }
+        }
+    }
+
+    if (worker->pendingCount > 0) addScores(worker->store, worker->pending, worker->pendingCount);
+    freeGame(state);
+    return NULL;
+}
+
+/* Function responsible of taking the next game from the front of the worker's own queue */
+static bool takeGame(WorkQueue *queue, uint32_t *game) {
+    uint64_t range = atomic_load_explicit(&queue->range, memory_order_acquire);
+
+    for (;;) {
+        uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if (begin >= end) return false;
+
+        if (atomic_compare_exchange_weak_explicit(&queue->range, &range, packRange(begin + 1, end),
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            *game = begin;
+            return true;
+        }
+    }
+}
+
+/* Function responsible of moving the back half of a victim's queue into an empty queue */
+static bool stealGames(WorkQueue *victim, WorkQueue *self) {
+    uint64_t range = atomic_load_explicit(&victim->range, memory_order_acquire);
+
+    for (;;) {
+        uint32_t begin = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if (begin >= end) return false;
+
+        uint32_t split = end - (end - begin + 1) / 2;
+        if (atomic_compare_exchange_weak_explicit(&victim->range, &range, packRange(begin, split),
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            /* Our queue is empty so nobody else can be changing it */
+            atomic_store_explicit(&self->range, packRange(split, end), memory_order_release);
+            return true;
+        }
+    }
+}
+
+/* Function responsible of returning the score at the given percentile of the distribution */
+static unsigned long scorePercentile(const unsigned long *scores, unsigned int maxScore, unsigned long games, double p) {
+    unsigned long target = (unsigned long)(p * (games > 0 ? games - 1 : 0));
+    unsigned long seen = 0;
+
+    for (unsigned int s = 0; s <= maxScore; s++) {
+        seen += scores[s];
+        if (scores[s] > 0 && seen > target) return s;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdio.h>
+#include <stdint.h>
+#include "level.h"
+#include "scores.h"
+
+/* Batch constants */
+#define BATCH_STARVATION 4          /* a game ends after board cells * this many ticks without eating */
+/* */
+
+/* Function prototypes */
+void runBatch(unsigned long games, unsigned int workers, uint64_t seed, int width, int height, const Level *level,
+              ScoreStore *store, FILE *out);
+/* */
+
+#endif //BATCH_H
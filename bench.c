@@ -0,0 +1,258 @@
+/* 
+ * bench.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ncurses.h>
+#include "game.h"
+#include "render.h"
+#include "snapshot.h"
+/* */
+
+/* Benchmark constants */
+#define BENCH_SAMPLES    2000       /* timed samples per operation, board and fill ratio */
+#define BENCH_BATCH      64         /* operations per sample for the ones too fast to time alone */
+/* */
+
+/* Operations measured by the benchmark */
+typedef enum {
+    OP_UPDATE_SNAKE,
+    OP_SNAKE_COLLISION,
+    OP_UPDATE_APPLE,
+    OP_DRAW_GAME,
+    OP_DRAW_ANSI,
+    OP_FORK_GAME
+} Operation;
+
+/* Benchmark context for one board and fill ratio */
+typedef struct Bench {
+    GameState *state;
+    Position *cycle;                /* Hamiltonian cycle over the inner board */
+    int cells;                      /* cells in the cycle */
+    int next;                       /* next cell of the cycle for the head */
+    unsigned int probe;             /* pseudo random cell probed by snakeCollision */
+    Snapshot *snapshot;             /* room for a snapshot of the longest snake */
+    GameState *fork;                /* game the snapshot is restored into */
+} Bench;
+/* */
+
+/* Function prototypes */
+static long long now();
+static int buildCycle(const GameState *state, Position *cycle);
+static void placeSnake(Bench *bench, int length);
+static void moveAlongCycle(Bench *bench);
+static double runOperation(Bench *bench, Operation op);
+static int compareDoubles(const void *a, const void *b);
+/* */
+
+int main() {
+    static const int sizes[][2] = { {22, 12}, {50, 20}, {100, 50}, {200, 100} };
+    static const int fills[] = {1, 10, 25, 50, 75, 90, 99};
+    static const char *names[] = { "updateSnake", "snakeCollision", "updateApple", "drawGame", "drawGameAnsi", "forkGame" };
+    static double samples[BENCH_SAMPLES];
+
+    /* Draw into an offscreen terminal large enough for every board, all output of both backends goes to /dev/null */
+    setenv("LINES", "200", 1);
+    setenv("COLUMNS", "300", 1);
+    FILE *nullOut = fopen("/dev/null", "w");
+    FILE *nullIn = fopen("/dev/null", "r");
+    SCREEN *screen = newterm("xterm", nullOut, nullIn);
+    if (screen == NULL) {
+        fprintf(stderr, "ERROR: Could not open an offscreen terminal.\n");
+        return 1;
+    }
+    ansiOutput = fileno(nullOut);
+
+    /* Machine-readable results, one line per operation, board and fill ratio */
+    printf("op,width,height,fill,length,samples,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        Bench bench;
+        bench.state = startGame(sizes[s][0], sizes[s][1], 1);
+        bench.cycle = malloc((size_t)sizes[s][0] * sizes[s][1] * sizeof(Position));
+        bench.cells = buildCycle(bench.state, bench.cycle);
+        bench.snapshot = malloc(snapshotSize(sizes[s][0], sizes[s][1], sizes[s][0] * sizes[s][1], 0));
+        bench.fork = startGame(sizes[s][0], sizes[s][1], 1);
+        cursesRenderer.start(sizes[s][0], sizes[s][1]);
+        ansiRenderer.start(sizes[s][0], sizes[s][1]);
+
+        for (unsigned int f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+            int length = bench.cells * fills[f] / 100;
+            if (length < 2) length = 2;
+
+            for (int op = OP_UPDATE_SNAKE; op <= OP_FORK_GAME; op++) {
+                renderer = op == OP_DRAW_ANSI ? &ansiRenderer : &cursesRenderer;
+                placeSnake(&bench, length);
+
+                for (int i = 0; i < BENCH_SAMPLES; i++) {
+                    samples[i] = runOperation(&bench, op);
+                }
+                if (!bench.state->isAlive) fprintf(stderr, "WARNING: the snake died during the benchmark\n");
+
+                double sum = 0;
+                for (int i = 0; i < BENCH_SAMPLES; i++) sum += samples[i];
+                qsort(samples, BENCH_SAMPLES, sizeof(double), compareDoubles);
+
+                printf("%s,%d,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n", names[op], sizes[s][0], sizes[s][1],
+                       fills[f], length, BENCH_SAMPLES, sum / BENCH_SAMPLES,
+                       samples[BENCH_SAMPLES / 2], samples[BENCH_SAMPLES * 90 / 100],
+                       samples[BENCH_SAMPLES * 99 / 100], samples[BENCH_SAMPLES - 1]);
+            }
+        }
+
+        ansiRenderer.stop();
+        cursesRenderer.stop();
+        freeGame(bench.state);
+        freeGame(bench.fork);
+        free(bench.snapshot);
+        free(bench.cycle);
+    }
+
+    endwin();
+    delscreen(screen);
+    fclose(nullOut);
+    fclose(nullIn);
+    return 0;
+}
+
+/* Function returning a monotonic timestamp in nanoseconds */
+static long long now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Function returning the time of one sample of an operation, in nanoseconds per operation */
+static double runOperation(Bench *bench, Operation op) {
+    GameState *state = bench->state;
+    long long start = 0, end = 0;
+
+    switch (op) {
+        case OP_UPDATE_SNAKE:
+            /* The head has to be steered along the cycle, which is part of the measured tick */
+            start = now();
+            for (int i = 0; i < BENCH_BATCH; i++) moveAlongCycle(bench);
+            end = now();
+            clearDirty(state);
+            return (double)(end - start) / BENCH_BATCH;
+        case OP_SNAKE_COLLISION: {
+            volatile int sink = 0;
+            int width = state->board.width, height = state->board.height;
+            start = now();
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                bench->probe = bench->probe * 1103515245u + 12345u;
+                sink += snakeCollision(state, (bench->probe >> 8) % width, (bench->probe >> 20) % height, true);
+            }
+            end = now();
+            (void)sink;
+            return (double)(end - start) / BENCH_BATCH;
+        }
+        case OP_UPDATE_APPLE:
+            start = now();
+            for (int i = 0; i < BENCH_BATCH; i++) updateApple(state);
+            end = now();
+            clearDirty(state);
+            return (double)(end - start) / BENCH_BATCH;
+        case OP_DRAW_GAME:
+        case OP_DRAW_ANSI:
+            /* Only the frame is timed, the tick that changed the board is not */
+            moveAlongCycle(bench);
+            start = now();
+            drawGame(state);
+            renderer->present();
+            end = now();
+            return (double)(end - start);
+        case OP_FORK_GAME:
+            /* What a search does for every rollout: flatten the game and restore it into a scratch one */
+            start = now();
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                captureGame(state, bench->snapshot);
+                restoreGame(bench->fork, bench->snapshot);
+            }
+            end = now();
+            return (double)(end - start) / BENCH_BATCH;
+    }
+
+    return 0;
+}
+
+/* Function moving the snake one cell further along the cycle */
+static void moveAlongCycle(Bench *bench) {
+    GameState *state = bench->state;
+    Position *head = snakeSegment(state, 0);
+    Position *to = &bench->cycle[bench->next];
+
+    state->snake.direction = to->pX > head->pX ? RIGHT : to->pX < head->pX ? LEFT : to->pY > head->pY ? DOWN : UP;
+    updateSnake(state);
+    if (++bench->next == bench->cells) bench->next = 0;
+}
+
+/* Function building a Hamiltonian cycle over the inner board, returns its length */
+static int buildCycle(const GameState *state, Position *cycle) {
+    int width = state->board.width, height = state->board.height;
+    int n = 0;
+
+    /* Sweep the rows back and forth over every column but the first one... */
+    for (int y = 1; y < height - 1; y++) {
+        for (int i = 0; i < width - 3; i++) {
+            int x = (y % 2) ? 2 + i : width - 2 - i;
+            cycle[n++] = (Position){x, y};
+        }
+    }
+
+    /* ...and come back up through the first column (needs an even number of inner rows) */
+    for (int y = height - 2; y >= 1; y--) {
+        cycle[n++] = (Position){1, y};
+    }
+
+    return n;
+}
+
+/* Function resetting the game with a snake laid over the first cells of the cycle */
+static void placeSnake(Bench *bench, int length) {
+    GameState *state = bench->state;
+    resetGame(state);
+
+    /* Keep the apple inside a wall so that the snake never eats it */
+    state->apple.pX = 0;
+    state->apple.pY = 0;
+
+    /* Replace the starting body with one running along the cycle */
+    while (state->snake.length > 0) popSnakeTail(state);
+    for (int i = 0; i < length; i++) pushSnakeHead(state, bench->cycle[i].pX, bench->cycle[i].pY);
+    bench->next = length % bench->cells;
+    bench->probe = 1;
+
+    /* Start drawing from a complete frame */
+    renderer->clearScreen();
+    drawBoard(state);
+    renderer->finishFrame();
+    renderer->present();
+}
+
+/* Function comparing two samples for qsort */
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,82 @@
+/* 
+ * bot.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdlib.h>
+#include "bot.h"
+/* */
+
+/* Movement of each direction, indexed by Direction */
+static const int moveX[] = { 0, 0, -1, 1 };
+static const int moveY[] = { -1, 1, 0, 0 };
+static const Input turnInput[] = { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT };
+static const Direction opposite[] = { DOWN, UP, RIGHT, LEFT };
+/* */
+
+/* Function prototypes for the internal helpers */
+static int axisDistance(int from, int to, int size, bool wrap);
+/* */
+
+/* Function responsible of picking a move that heads to the apple without dying on the next tick */
+Input greedyInput(const GameState *state) {
+    const Board *board = &state->board;
+    bool wraps = board->wrapX || board->wrapY;
+    Position *head = snakeSegment(state, 0);
+    Direction current = state->snake.direction;
+    int bestScore = -(1 << 30);
+    Input best = INPUT_NONE;
+
+    for (int d = UP; d <= RIGHT; d++) {
+        /* The snake can not turn back on itself */
+        if (d == (int)opposite[current]) continue;
+
+        int x = head->pX + moveX[d];
+        int y = head->pY + moveY[d];
+        if (wraps) wrapCell(board, &x, &y);
+        if (cellBlocked(state, x, y)) continue;
+
+        /* Prefer getting closer to the apple, then having room to move afterwards */
+        int room = 0;
+        for (int n = UP; n <= RIGHT; n++) {
+            int nx = x + moveX[n], ny = y + moveY[n];
+            if (wraps) wrapCell(board, &nx, &ny);
+            room += !cellBlocked(state, nx, ny);
+        }
+        int distance = axisDistance(x, state->apple.pX, board->width, board->wrapX) +
+                       axisDistance(y, state->apple.pY, board->height, board->wrapY);
+        int score = -distance * 4 + room;
+        if (room == 0) score -= 1 << 20;
+
+        if (score > bestScore) {
+            bestScore = score;
+            best = turnInput[d];
+        }
+    }
+
+    /* When every move is deadly keep going, the game is over anyway */
+    return best;
+}
+
+/* Function returning the distance between two coordinates, the short way around when the axis wraps */
+static int axisDistance(int from, int to, int size, bool wrap) {
+    int distance = abs(to - from);
+    return wrap && size - distance < distance ? size - distance : distance;
+}
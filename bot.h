@@ -0,0 +1,9 @@
+#ifndef BOT_H
+#define BOT_H
+#include "game.h"
+
+/* Function prototypes */
+Input greedyInput(const GameState *state);
+/* */
+
+#endif //BOT_H
@@ -0,0 +1,248 @@
+/* 
+ * food.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+/* */
+
+/* Function prototypes for the internal helpers */
+static uint32_t foodHome(const FoodSet *food, unsigned int cell);
+static uint32_t *foodSlot(const FoodSet *food, unsigned int cell, int width);
+static bool spawnFood(GameState *state);
+static void removeFood(GameState *state, uint32_t slot);
+/* */
+
+/* Slot a cell's probe run starts at. Multiplying by the golden ratio mixes every bit of the cell into the high bits
+ * of the product, so those are kept: the low ones would only depend on the low bits of the cell */
+static uint32_t foodHome(const FoodSet *food, unsigned int cell) {
+    return (uint32_t)cell * 0x9E3779B1u >> food->tableShift;
+}
+
+/* Find the table slot holding the item on the cell, or the empty slot ending its probe run */
+static uint32_t *foodSlot(const FoodSet *food, unsigned int cell, int width) {
+    uint32_t slot = foodHome(food, cell);
+    for (;; slot = (slot + 1) & food->tableMask) {
+        uint32_t item = food->table[slot];
+        if (item == 0) break;
+        const FoodItem *found = &food->items[item - 1];
+        if ((unsigned int)found->pY * width + found->pX == cell) break;
+    }
+    return &food->table[slot];
+}
+
+/* Function responsible of sizing the food set for the given number of items, 0 turns it off.
+ * The set starts empty, startFood or resetGame fill the board */
+void setFood(GameState *state, unsigned int target) {
+    FoodSet *food = &state->food;
+    freeFood(state);
+    if (target == 0) return;
+
+    /* The table stays at most half full so probe runs stay short */
+    uint32_t slots = 1;
+    while (slots < 2 * target) slots <<= 1;
+    food->target = target;
+    food->items = malloc(target * sizeof(FoodItem));
+    food->table = malloc(slots * sizeof(uint32_t));
+    food->tableMask = slots - 1;
+    food->tableShift = 32 - __builtin_ctz(slots);
+    emptyFood(state);
+}
+
+/* Function responsible of taking every item off the board without redrawing them */
+void emptyFood(GameState *state) {
+    FoodSet *food = &state->food;
+    if (food->target == 0) return;
+
+    /* Chain the whole pool as unused */
+    for (uint32_t i = 0; i < food->target; i++) {
+        food->items[i].next = i + 2 <= food->target ? i + 2 : 0;
+    }
+    food->unused = 1;
+    food->count = 0;
+    memset(food->table, 0, (food->tableMask + 1) * sizeof(uint32_t));
+    memset(food->wheel, 0, sizeof(food->wheel));
+}
+
+/* Function responsible of emptying the food set and filling the board with new items */
+void startFood(GameState *state) {
+    FoodSet *food = &state->food;
+    emptyFood(state);
+    while (food->count < food->target && spawnFood(state));
+}
+
+/* Function responsible of putting an item on a free cell, returns false when the pool is used up */
+bool addFood(GameState *state, int x, int y, FoodKind kind, unsigned long expires) {
+    FoodSet *food = &state->food;
+    if (food->unused == 0) return false;
+
+    /* Take an item from the pool */
+    uint32_t index = food->unused;
+    FoodItem *item = &food->items[index - 1];
+    food->unused = item->next;
+    item->pX = x;
+    item->pY = y;
+    item->kind = kind;
+    item->expires = expires;
+
+    /* Timed items are also chained in the wheel slot of the tick they expire on */
+    if (expires) {
+        uint32_t *bucket = &food->wheel[expires % FOOD_WHEEL];
+        item->prev = 0;
+        item->next = *bucket;
+        if (*bucket) food->items[*bucket - 1].prev = index;
+        *bucket = index;
+    }
+
+    *foodSlot(food, (unsigned int)y * state->board.width + x, state->board.width) = index;
+    food->count++;
+    markDirty(state, x, y);
+    return true;
+}
+
+/* Function responsible of finding the food item on a cell, NULL when there is none */
+const FoodItem *findFood(const GameState *state, int x, int y) {
+    const FoodSet *food = &state->food;
+    if (food->count == 0) return NULL;
+
+    uint32_t item = *foodSlot(food, (unsigned int)y * state->board.width + x, state->board.width);
+    return item ? &food->items[item - 1] : NULL;
+}
+
+/* Place one item of a random kind on a free cell, returns false when no cell was found */
+static bool spawnFood(GameState *state) {
+    FoodSet *food = &state->food;
+    Board *board = &state->board;
+    unsigned int cells = (unsigned int)board->width * board->height;
+    if (food->unused == 0 || board->freeCount == 0) return false;
+
+    /* Same draw as the apple, but a few misses only mean the item comes back on a later tick */
+    int x = 0, y = 0;
+    bool found = false;
+    for (int tries = 0; tries < APPLE_TRIES && !found; tries++) {
+        unsigned int cell = board->freeCount >= cells / 4
+                          ? boundedRng(&state->rng, cells)
+                          : boardSelect(board, boundedRng(&state->rng, board->freeCount));
+        x = cell % board->width;
+        y = cell / board->width;
+        found = !boardTest(board->occupied, cell) && !appleCollision(state, x, y) &&
+                *foodSlot(food, cell, board->width) == 0;
+    }
+    if (!found) return false;
+
+    /* One in sixteen is a bonus, one in four timed, the rest stay until eaten */
+    unsigned int roll = boundedRng(&state->rng, 16);
+    FoodKind kind = roll == 0 ? FOOD_BONUS : roll <= 4 ? FOOD_TIMED : FOOD_NORMAL;
+    unsigned long expires = kind == FOOD_NORMAL ? 0
+                          : state->ticks + (kind == FOOD_BONUS ? FOOD_BONUS_TICKS : FOOD_TIMED_TICKS);
+    return addFood(state, x, y, kind, expires);
+}
+
+/* Take the item in the table slot off the board and give it back to the pool */
+static void removeFood(GameState *state, uint32_t slot) {
+    FoodSet *food = &state->food;
+    uint32_t index = food->table[slot];
+    FoodItem *item = &food->items[index - 1];
+    int width = state->board.width;
+
+    /* Unlink it from its expiry wheel slot */
+    if (item->expires) {
+        if (item->prev) food->items[item->prev - 1].next = item->next;
+        else food->wheel[item->expires % FOOD_WHEEL] = item->next;
+        if (item->next) food->items[item->next - 1].prev = item->prev;
+    }
+
+    /* Shift the rest of the probe run back so no tombstones are needed */
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & food->tableMask; food->table[next]; next = (next + 1) & food->tableMask) {
+        const FoodItem *moved = &food->items[food->table[next] - 1];
+        uint32_t home = foodHome(food, (unsigned int)moved->pY * width + moved->pX);
+        /* The entry may fill the hole only when its home is not between the hole and itself */
+        if (((next - home) & food->tableMask) >= ((next - hole) & food->tableMask)) {
+            food->table[hole] = food->table[next];
+            hole = next;
+        }
+    }
+    food->table[hole] = 0;
+
+    markDirty(state, item->pX, item->pY);
+    item->next = food->unused;
+    food->unused = index;
+    food->count--;
+}
+
+/* Function responsible of eating the food item on a cell, returns whether there was one */
+bool eatFood(GameState *state, int x, int y) {
+    FoodSet *food = &state->food;
+    if (food->count == 0) return false;
+
+    uint32_t *slot = foodSlot(food, (unsigned int)y * state->board.width + x, state->board.width);
+    if (*slot == 0) return false;
+
+    /* Like the apple the snake grows by the new head now and one more segment later, bonus items give more */
+    state->snake.growth += 1 + (food->items[*slot - 1].kind == FOOD_BONUS ? FOOD_BONUS_GROWTH : 0);
+    removeFood(state, slot - food->table);
+    return true;
+}
+
+/* Function responsible of expiring the timed items of this tick and placing missing ones again */
+void updateFood(GameState *state) {
+    FoodSet *food = &state->food;
+    if (food->target == 0) return;
+
+    /* Lifetimes are shorter than a turn of the wheel, so the slot holds exactly the items expiring now */
+    uint32_t index = food->wheel[state->ticks % FOOD_WHEEL];
+    while (index) {
+        const FoodItem *item = &food->items[index - 1];
+        uint32_t next = item->next;
+        removeFood(state, foodSlot(food, (unsigned int)item->pY * state->board.width + item->pX,
+                                   state->board.width) - food->table);
+        index = next;
+    }
+
+    for (int i = 0; i < FOOD_SPAWNS && food->count < food->target; i++) {
+        if (!spawnFood(state)) break;
+    }
+}
+
+/* Function responsible of copying the food items of a game with the same target */
+void copyFood(GameState *copy, const GameState *state) {
+    FoodSet *food = &copy->food;
+    const FoodSet *from = &state->food;
+    if (from->target == 0) return;
+
+    memcpy(food->items, from->items, from->target * sizeof(FoodItem));
+    memcpy(food->table, from->table, (from->tableMask + 1) * sizeof(uint32_t));
+    memcpy(food->wheel, from->wheel, sizeof(food->wheel));
+    food->count = from->count;
+    food->unused = from->unused;
+}
+
+/* Function responsible of freeing the food set */
+void freeFood(GameState *state) {
+    FoodSet *food = &state->food;
+    free(food->items);
+    free(food->table);
+    memset(food, 0, sizeof(FoodSet));
+}
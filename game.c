@@ -0,0 +1,491 @@
+/* 
+ * game.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "level.h"
+/* */
+
+/* Function prototypes for the internal helpers */
+static void startBoard(GameState *state);
+static void startSnake(GameState *state);
+static void startApple(GameState *state);
+/* */
+
+/* Find the free cell with the given rank, skipping whole blocks, then whole words, then bits */
+unsigned int boardSelect(const Board *board, unsigned int rank) {
+    size_t word = 0;
+    for (size_t block = 0; rank >= board->blockFree[block]; block++) {
+        rank -= board->blockFree[block];
+        word += BOARD_BLOCK_WORDS;
+    }
+
+    for (;; word++) {
+        unsigned int free = 64 - __builtin_popcountll(board->occupied[word]);
+        if (rank < free) break;
+        rank -= free;
+    }
+
+    /* Drop the lowest free bits until the wanted one is the lowest */
+    uint64_t bits = ~board->occupied[word];
+    while (rank-- > 0) bits &= bits - 1;
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+/* Place the apple on a free cell drawn uniformly, returns false when the board is full */
+static bool placeApple(GameState *state) {
+    Board *board = &state->board;
+    unsigned int cells = (unsigned int)board->width * board->height;
+    if (board->freeCount == 0) return false;
+
+    /* Random cells are uniform over the free ones and usually free on a roomy board,
+     * a crowded board, or a run of bad luck, draws a rank among the free cells instead */
+    int tries = board->freeCount >= cells / 4 ? APPLE_TRIES : 0;
+    /* Food items are skipped too while some free cell holds none */
+    bool avoidFood = state->food.count > 0 && board->freeCount > state->food.count;
+    unsigned int cell;
+    do {
+        cell = tries-- > 0 ? boundedRng(&state->rng, cells)
+                           : boardSelect(board, boundedRng(&state->rng, board->freeCount));
+    } while (boardTest(board->occupied, cell) || (avoidFood && findFood(state, cell % board->width, cell / board->width)));
+
+    state->apple.pX = cell % board->width;
+    state->apple.pY = cell / board->width;
+    markDirty(state, state->apple.pX, state->apple.pY);
+    return true;
+}
+/* */
+
+/* Function responsible of allocating a new game on a board of the given size */
+GameState *startGame(int width, int height, uint64_t seed) {
+    /* Allocate memory for a new game */
+    GameState *state = malloc(sizeof(GameState));
+    size_t cells = (size_t)width * height;
+
+    /* Allocate both bitmaps, rounding up to whole 64-bit words, and a free count per block of words */
+    size_t words = (cells + 63) / 64;
+    size_t blocks = (words + BOARD_BLOCK_WORDS - 1) / BOARD_BLOCK_WORDS;
+    state->board.width = width;
+    state->board.height = height;
+    state->board.occupied = malloc(words * sizeof(uint64_t));
+    state->board.walls = malloc(words * sizeof(uint64_t));
+    state->board.blockFree = malloc(blocks * sizeof(uint16_t));
+
+    /* Preallocate the ring buffer so the snake never needs to allocate while it moves,
+     * pages are only touched as the snake grows into them */
+    state->snake.capacity = cells;
+    state->snake.body = malloc(cells * sizeof(Position));
+
+    /* No extra food items until setFood asks for them, and the empty box until setLevel asks for a level */
+    memset(&state->food, 0, sizeof(FoodSet));
+    state->board.level = NULL;
+
+    /* Set up the first game */
+    seedGame(state, seed, 0);
+    resetGame(state);
+
+    /* Return the initialized game */
+    return state;
+}
+
+/* Function responsible of seeding the game's own random number generator with one of the seed's streams */
+void seedGame(GameState *state, uint64_t seed, uint64_t stream) {
+    seedRng(&state->rng, seed, stream);
+}
+
+/* Function responsible of starting a new game, reusing the memory of the previous one */
+void resetGame(GameState *state) {
+    state->isAlive = true;
+    state->isWon = false;
+    state->isPaused = false;
+    state->speed = MIN_SPEED;
+    state->ticks = 0;
+    clearDirty(state);
+
+    startBoard(state);
+    startSnake(state);
+    startApple(state);
+    startFood(state);
+}
+
+/* Function responsible of building the next games on a level instead of the empty box, NULL goes back to the box.
+ * The level must have the size of the board, the current game is left as it is until resetGame */
+void setLevel(GameState *state, const Level *level) {
+    state->board.level = level;
+}
+
+/* Function responsible of initializing the occupancy grid */
+static void startBoard(GameState *state) {
+    Board *board = &state->board;
+    size_t cells = (size_t)board->width * board->height;
+    size_t words = (cells + 63) / 64;
+
+    if (board->level != NULL) {
+        /* A level already holds its walls in the layout of the grid, a single copy out of the mapping */
+        memcpy(board->walls, levelWalls(board->level), words * sizeof(uint64_t));
+        board->wrapX = board->level->wrap & LEVEL_WRAP_X;
+        board->wrapY = board->level->wrap & LEVEL_WRAP_Y;
+    } else {
+        /* Clear the walls, then mark the borders, only the border cells are visited so big boards reset quickly */
+        memset(board->walls, 0, words * sizeof(uint64_t));
+        for (int x = 0; x < board->width; x++) {
+            boardSet(board->walls, boardCell(board, x, 0));
+            boardSet(board->walls, boardCell(board, x, board->height - 1));
+        }
+        for (int y = 1; y < board->height - 1; y++) {
+            boardSet(board->walls, boardCell(board, 0, y));
+            boardSet(board->walls, boardCell(board, board->width - 1, y));
+        }
+        board->wrapX = false;
+        board->wrapY = false;
+    }
+
+    /* Walls are occupied, and so are the padding bits past the last cell so they are never counted as free */
+    memcpy(board->occupied, board->walls, words * sizeof(uint64_t));
+    if (cells % 64) board->occupied[words - 1] |= ~(uint64_t)0 << (cells % 64);
+
+    /* Count the free cells of every block */
+    board->freeCount = 0;
+    for (size_t word = 0; word < words; word += BOARD_BLOCK_WORDS) {
+        unsigned int free = 0;
+        for (size_t i = word; i < word + BOARD_BLOCK_WORDS && i < words; i++) {
+            free += 64 - __builtin_popcountll(board->occupied[i]);
+        }
+        board->blockFree[word / BOARD_BLOCK_WORDS] = free;
+        board->freeCount += free;
+    }
+}
+
+/* Function responsible of initializing the snake strucutre */
+static void startSnake(GameState *state) {
+    Snake *snake = &state->snake;
+    snake->head = 0;
+    snake->length = 0;
+    snake->growth = 0;
+
+    /* A level decides where the head starts and which way it goes, the empty box starts it upward from the center */
+    const Level *level = state->board.level;
+    snake->direction = level != NULL ? (Direction)level->direction : UP;
+    int headX = level != NULL ? level->spawnX : state->board.width / 2;
+    int headY = level != NULL ? level->spawnY : state->board.height / 2;
+    int dx = snake->direction == LEFT ? -1 : snake->direction == RIGHT ? 1 : 0;
+    int dy = snake->direction == UP ? -1 : snake->direction == DOWN ? 1 : 0;
+
+    /* Build the initial body in a straight line behind the head, pushing from the tail towards the head */
+    for (int i = START_SNAKE_SIZE - 1; i >= 0; i--) {
+        int x = headX - i * dx, y = headY - i * dy;
+        wrapCell(&state->board, &x, &y);
+        pushSnakeHead(state, x, y);
+    }
+}
+
+/* Function responsible of initializing the apple structure */
+static void startApple(GameState *state) {
+    /* Place the new apple on a random free cell */
+    placeApple(state);
+}
+
+/* Function responsible of freeing the memory for a game */
+void freeGame(GameState *state) {
+    /* Free the bitmaps, the free counts, the ring buffer and the game structure itself */
+    free(state->board.occupied);
+    free(state->board.walls);
+    free(state->board.blockFree);
+    free(state->snake.body);
+    freeFood(state);
+    free(state);
+}
+
+/* Function responsible of copying a game into another one with the same board size and food target.
+ * Nothing is allocated, only the grids and the live part of the ring buffer are copied */
+void copyGame(GameState *copy, const GameState *state) {
+    Board *board = &copy->board;
+    size_t words = ((size_t)board->width * board->height + 63) / 64;
+    size_t blocks = (words + BOARD_BLOCK_WORDS - 1) / BOARD_BLOCK_WORDS;
+    memcpy(board->occupied, state->board.occupied, words * sizeof(uint64_t));
+    memcpy(board->walls, state->board.walls, words * sizeof(uint64_t));
+    memcpy(board->blockFree, state->board.blockFree, blocks * sizeof(uint16_t));
+    board->freeCount = state->board.freeCount;
+    board->wrapX = state->board.wrapX;
+    board->wrapY = state->board.wrapY;
+    board->level = state->board.level;
+
+    /* The body keeps its slots in the ring, so it is at most two runs */
+    const Snake *snake = &state->snake;
+    unsigned int first = snake->capacity - snake->head;
+    if (first > snake->length) first = snake->length;
+    memcpy(&copy->snake.body[snake->head], &snake->body[snake->head], first * sizeof(Position));
+    memcpy(copy->snake.body, snake->body, (snake->length - first) * sizeof(Position));
+    copy->snake.direction = snake->direction;
+    copy->snake.head = snake->head;
+    copy->snake.length = snake->length;
+    copy->snake.growth = snake->growth;
+
+    copy->apple = state->apple;
+    copyFood(copy, state);
+    copy->isAlive = state->isAlive;
+    copy->isWon = state->isWon;
+    copy->isPaused = state->isPaused;
+    copy->speed = state->speed;
+    copy->ticks = state->ticks;
+    copy->rng = state->rng;
+    clearDirty(copy);
+}
+
+/* Function responsible of advancing the game by one tick with the given input */
+void stepGame(GameState *state, Input input) {
+    applyInput(state, input);
+
+    /* Check if the game is not paused before updating the snake position */
+    if (state->isAlive && !state->isPaused) {
+        updateSnake(state);
+    }
+}
+
+/* Function responsible of applying an input to the game, returns whether it changed the direction or pause state */
+bool applyInput(GameState *state, Input input) {
+    Snake *snake = &state->snake;
+    Direction direction = snake->direction;
+    bool paused = state->isPaused;
+
+    /* Handle different inputs to change the snake's direction */
+    switch (input) {
+        case INPUT_UP:
+            state->isPaused = false;
+            /* If the snake is not currently moving down, change its direction to up */
+            if (snake->direction != DOWN) snake->direction = UP;
+            break;
+        case INPUT_DOWN:
+            state->isPaused = false;
+            /* If the snake is not currently moving up, change its direction to down */
+            if (snake->direction != UP) snake->direction = DOWN;
+            break;
+        case INPUT_RIGHT:
+            state->isPaused = false;
+            /* If the snake is not currently moving left, change its direction to right */
+            if (snake->direction != LEFT) snake->direction = RIGHT;
+            break;
+        case INPUT_LEFT:
+            state->isPaused = false;
+            /* If the snake is not currently moving right, change its direction to left */
+            if (snake->direction != RIGHT) snake->direction = LEFT;
+            break;
+        case INPUT_PAUSE:
+            state->isPaused = !state->isPaused;
+            break;
+        default:
+            /* Do nothing for other inputs */
+            break;
+    }
+
+    return snake->direction != direction || state->isPaused != paused;
+}
+
+/* Function responsible of returning the segment at the given index (0 is the head) */
+Position *snakeSegment(const GameState *state, unsigned int index) {
+    const Snake *snake = &state->snake;
+    unsigned int pos = snake->head + index;
+
+    /* Wrap around the end of the ring buffer */
+    if (pos >= snake->capacity) pos -= snake->capacity;
+
+    return &snake->body[pos];
+}
+
+/* Function responsible of adding a new head to the snake */
+void pushSnakeHead(GameState *state, int x, int y) {
+    Snake *snake = &state->snake;
+
+    /* The old head turns into a body segment */
+    if (snake->length > 0) markDirty(state, snake->body[snake->head].pX, snake->body[snake->head].pY);
+    markDirty(state, x, y);
+
+    /* Step the head index back, wrapping around the start of the ring buffer */
+    snake->head = (snake->head == 0 ? snake->capacity : snake->head) - 1;
+    snake->body[snake->head].pX = x;
+    snake->body[snake->head].pY = y;
+    snake->length++;
+
+    /* Mark the new head on the occupancy grid */
+    boardTake(&state->board, boardCell(&state->board, x, y));
+}
+
+/* Function responsible of removing the tail of the snake */
+void popSnakeTail(GameState *state) {
+    /* Free the tail's cell on the occupancy grid */
+    Position *tail = snakeSegment(state, state->snake.length - 1);
+    boardRelease(&state->board, boardCell(&state->board, tail->pX, tail->pY));
+    markDirty(state, tail->pX, tail->pY);
+
+    /* The tail is the last used slot, so shrinking the length drops it */
+    state->snake.length--;
+}
+
+/* Function responsible of saving the size of the snake */
+int snakeSize(const GameState *state) {
+    /* The length is kept up to date on every push and pop */
+    return state->snake.length;
+}
+
+/* Function responsible of computing the score of a game */
+int gameScore(const GameState *state) {
+    return snakeSize(state) - START_SNAKE_SIZE;
+}
+
+/* Function responsible of handling the snake's movement, eating the apple when it is reached */
+void updateSnake(GameState *state) {
+    if (moveSnake(state)) feedSnake(state);
+}
+
+/* Function responsible of moving the snake one cell, returns whether the head reached the apple.
+ * Food items are eaten and replaced here as they never change the speed */
+bool moveSnake(GameState *state) {
+    Snake *snake = &state->snake;
+
+    /* Calculate the new coordinates for the head of the snake */
+    Position *head = snakeSegment(state, 0);
+    int new_head_x = head->pX + (snake->direction == LEFT ? -1 : snake->direction == RIGHT ? 1 : 0);
+    int new_head_y = head->pY + (snake->direction == UP ? -1 : snake->direction == DOWN ? 1 : 0);
+    wrapCell(&state->board, &new_head_x, &new_head_y);
+
+    /* Check if the new head position does not overlap with an apple */
+    bool ateApple = appleCollision(state, new_head_x, new_head_y);
+    bool ateFood = eatFood(state, new_head_x, new_head_y);
+
+    /* Let the tail follow the head, unless the snake is growing or just ate */
+    if (!ateApple && !ateFood) {
+        if (snake->growth > 0) {
+            snake->growth--;
+        } else {
+            popSnakeTail(state);
+        }
+    }
+
+    /* Check for collision with the game borders or itself, the grid holds both so it is a single lookup */
+    bool collided = cellBlocked(state, new_head_x, new_head_y);
+
+    /* Move the head to the new position */
+    pushSnakeHead(state, new_head_x, new_head_y);
+    state->ticks++;
+    updateFood(state);
+
+    if (collided) {
+        /* If there is a collision, set the snake as not alive */
+        state->isAlive = false;
+    }
+
+    return ateApple;
+}
+
+/* Function responsible of the effects of eating the apple */
+void feedSnake(GameState *state) {
+    /* The snake ate an apple, so it grows by the new head now and by one more segment on the next move */
+    state->snake.growth++;
+
+    /* Move the apple to a new position */
+    updateApple(state);
+
+    /* Increase the speed if it hasn't reached the maximum */
+    if (state->speed >= MAX_SPEED) {
+        state->speed -= 1;
+    }
+}
+
+/* Function responsible of moving the apple to a new position */
+void updateApple(GameState *state) {
+    /* Move the apple to a random free cell, if there is none the snake filled the board */
+    if (!placeApple(state)) {
+        state->apple.pX = -1;
+        state->apple.pY = -1;
+        state->isWon = true;
+        state->isAlive = false;
+    }
+}
+
+/* Function responsible of checking if the snake collided with itself */
+bool snakeCollision(const GameState *state, int x, int y, bool excludeHead) {
+    const Board *board = &state->board;
+
+    /* Positions outside of the board can not hold the snake */
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) return false;
+
+    /* An occupied cell that is not a wall belongs to the snake */
+    unsigned int cell = boardCell(board, x, y);
+    if (!boardTest(board->occupied, cell) || boardTest(board->walls, cell)) return false;
+
+    /* Unless excludeHead is set, the head itself does not count (same semantics as the body walk) */
+    if (!excludeHead) {
+        Position *head = snakeSegment(state, 0);
+        if (head->pX == x && head->pY == y) return false;
+    }
+
+    /* The snake occupies the specified position */
+    return true;
+}
+
+/* Function to chech if the snake ate an apple */
+bool appleCollision(const GameState *state, int x, int y) {
+    /* Check if the specified coordinates match the position of the apple */
+    return state->apple.pX == x && state->apple.pY == y;
+}
+
+/* Function responsible of checking if moving into a cell kills the snake (wall or body) */
+bool cellBlocked(const GameState *state, int x, int y) {
+    const Board *board = &state->board;
+
+    /* Everything outside of the board counts as a wall */
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) return true;
+
+    return boardTest(board->occupied, boardCell(board, x, y));
+}
+
+/* Function responsible of checking if a cell is a wall */
+bool wallCollision(const GameState *state, int x, int y) {
+    const Board *board = &state->board;
+
+    /* Everything outside of the board counts as a wall */
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) return true;
+
+    return boardTest(board->walls, boardCell(board, x, y));
+}
+
+/* Function responsible of remembering a cell that needs to be redrawn */
+void markDirty(GameState *state, int x, int y) {
+    /* Once the list is full a complete redraw is needed anyway */
+    if (state->dirtyCount == DIRTY_CAPACITY) {
+        state->dirtyOverflow = true;
+        return;
+    }
+
+    state->dirtyCells[state->dirtyCount].pX = x;
+    state->dirtyCells[state->dirtyCount].pY = y;
+    state->dirtyCount++;
+}
+
+/* Function responsible of forgetting the changed cells once they were redrawn */
+void clearDirty(GameState *state) {
+    state->dirtyCount = 0;
+    state->dirtyOverflow = false;
+}
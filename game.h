@@ -0,0 +1,204 @@
+#ifndef GAME_H
+#define GAME_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "rng.h"
+
+struct Level;
+
+/* Game constants */
+#define START_SNAKE_SIZE 5          /* snake's initial size */
+#define SCREEN_WIDTH     50         /* the default board width */
+#define SCREEN_HEIGHT    20         /* the default board height */
+#define MIN_BOARD_SIZE   12         /* smallest board side that still holds the starting snake */
+#define MAX_BOARD_SIZE   10000      /* largest board side, positions are stored in 16 bits */
+#define MIN_SPEED        100        /* default speed of the game (lower is faster) */
+#define MAX_SPEED        70         /* max speed of the game (lower is faster) */
+#define DIRTY_CAPACITY   64         /* changed cells remembered between two redraws */
+#define BOARD_BLOCK_WORDS 64        /* occupancy words summarized by each free cell count */
+#define APPLE_TRIES      16         /* random cells tried before counting through the free cells */
+#define FOOD_WHEEL       256        /* expiry wheel slots, more than the longest lifetime in ticks */
+#define FOOD_TIMED_TICKS 200        /* lifetime of a timed food item */
+#define FOOD_BONUS_TICKS 100        /* lifetime of a bonus food item */
+#define FOOD_BONUS_GROWTH 4         /* extra segments given by a bonus food item */
+#define FOOD_SPAWNS      8          /* missing food items placed again per tick */
+/* */
+
+/* Possible directions for the snake */
+typedef enum {
+    UP,
+    DOWN,
+    LEFT,
+    RIGHT
+} Direction;
+
+/* Possible inputs for a single step of the game */
+typedef enum {
+    INPUT_NONE,
+    INPUT_UP,
+    INPUT_DOWN,
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_PAUSE
+} Input;
+
+/* Position structure, kept to 4 bytes so a board-filling snake on the largest board stays small */
+typedef struct Position {
+    int16_t pX, pY;                 /* represents a position on the board */
+} Position;
+
+/* Snake structure (circular array of positions) */
+typedef struct Snake {
+    Direction direction;
+    Position *body;                 /* ring buffer with the snake's body, head first */
+    unsigned int capacity;          /* number of slots in the ring buffer */
+    unsigned int head;              /* index of the head inside the ring buffer */
+    unsigned int length;            /* number of segments in use */
+    unsigned int growth;            /* moves left before the tail starts following again */
+} Snake;
+
+/* Apple structure */
+typedef struct Food {
+    int pX, pY;    /* represents the apple's position on the board */
+} Apple;
+
+/* Kinds of the extra food items */
+typedef enum {
+    FOOD_NORMAL,                    /* stays until eaten */
+    FOOD_TIMED,                     /* disappears after FOOD_TIMED_TICKS */
+    FOOD_BONUS                      /* disappears after FOOD_BONUS_TICKS, grows the snake by FOOD_BONUS_GROWTH more */
+} FoodKind;
+
+/* Food item structure, links are item indexes plus one so that zero means none */
+typedef struct FoodItem {
+    int16_t pX, pY;
+    FoodKind kind;
+    unsigned long expires;          /* tick the item disappears on, 0 when it stays */
+    uint32_t next, prev;            /* neighbours in the expiry wheel slot, or the next unused item */
+} FoodItem;
+
+/* Food set structure, extra food items on top of the apple looked up by cell */
+typedef struct FoodSet {
+    unsigned int target;            /* items kept on the board, 0 when the food mode is off */
+    unsigned int count;             /* items on the board */
+    FoodItem *items;                /* pool of target items */
+    uint32_t unused;                /* first unused item of the pool */
+    uint32_t *table;                /* items by cell, open addressing with linear probing */
+    uint32_t tableMask;             /* table slots minus one, a power of two at least twice the target */
+    uint32_t tableShift;            /* 32 minus the bits of a slot number */
+    uint32_t wheel[FOOD_WHEEL];     /* timed items by the tick they expire on */
+} FoodSet;
+
+/* Board structure (bit-packed occupancy grid plus free cell counts to find the n-th free cell) */
+typedef struct Board {
+    int width, height;              /* board dimensions, borders included */
+    uint64_t *occupied;             /* one bit per cell taken by a wall or by the snake, padding bits included */
+    uint64_t *walls;                /* one bit per cell taken by a wall */
+    uint16_t *blockFree;            /* number of free cells in each block of BOARD_BLOCK_WORDS words */
+    unsigned int freeCount;         /* number of free cells */
+    bool wrapX, wrapY;              /* leaving through a side comes back through the opposite one */
+    const struct Level *level;      /* level new games are built on, NULL for the empty box */
+} Board;
+
+/* Game state structure, everything a single game needs and nothing about how it is shown */
+typedef struct GameState {
+    Board board;
+    Snake snake;
+    Apple apple;
+    FoodSet food;
+    bool isAlive;                   /* the snake is alive */
+    bool isWon;                     /* the snake filled the board */
+    bool isPaused;                  /* the game is paused */
+    unsigned int speed;             /* speed of the game (lower is faster) */
+    unsigned long ticks;            /* moves made since the game started */
+    Rng rng;                        /* private random number generator of this game */
+    Position dirtyCells[DIRTY_CAPACITY];   /* cells changed since the last redraw */
+    unsigned int dirtyCount;
+    bool dirtyOverflow;             /* too many changes were made, redraw everything */
+} GameState;
+
+/* Bit helpers for the occupancy grid, shared by the engines */
+static inline unsigned int boardCell(const Board *board, int x, int y) {
+    return (unsigned int)y * board->width + x;
+}
+
+static inline bool boardTest(const uint64_t *bits, unsigned int cell) {
+    return (bits[cell >> 6] >> (cell & 63)) & 1;
+}
+
+static inline void boardSet(uint64_t *bits, unsigned int cell) {
+    bits[cell >> 6] |= (uint64_t)1 << (cell & 63);
+}
+
+static inline void boardClear(uint64_t *bits, unsigned int cell) {
+    bits[cell >> 6] &= ~((uint64_t)1 << (cell & 63));
+}
+
+/* Bring a position that left through a wrapping side back on the board, other sides are walls */
+static inline void wrapCell(const Board *board, int *x, int *y) {
+    if (board->wrapX) {
+        if (*x < 0) *x += board->width;
+        else if (*x >= board->width) *x -= board->width;
+    }
+    if (board->wrapY) {
+        if (*y < 0) *y += board->height;
+        else if (*y >= board->height) *y -= board->height;
+    }
+}
+
+/* Mark a cell as taken by the snake, removing it from the free counts */
+static inline void boardTake(Board *board, unsigned int cell) {
+    if (boardTest(board->occupied, cell)) return;
+    boardSet(board->occupied, cell);
+
+    board->blockFree[cell / (64 * BOARD_BLOCK_WORDS)]--;
+    board->freeCount--;
+}
+
+/* Mark a cell as no longer taken by the snake, adding it back to the free counts */
+static inline void boardRelease(Board *board, unsigned int cell) {
+    if (!boardTest(board->occupied, cell) || boardTest(board->walls, cell)) return;
+    boardClear(board->occupied, cell);
+
+    board->blockFree[cell / (64 * BOARD_BLOCK_WORDS)]++;
+    board->freeCount++;
+}
+/* */
+
+/* Function prototypes */
+GameState *startGame(int width, int height, uint64_t seed);
+void seedGame(GameState *state, uint64_t seed, uint64_t stream);
+void resetGame(GameState *state);
+void setLevel(GameState *state, const struct Level *level);
+void freeGame(GameState *state);
+void copyGame(GameState *copy, const GameState *state);
+void stepGame(GameState *state, Input input);
+bool applyInput(GameState *state, Input input);
+Position *snakeSegment(const GameState *state, unsigned int index);
+void pushSnakeHead(GameState *state, int x, int y);
+void popSnakeTail(GameState *state);
+int snakeSize(const GameState *state);
+int gameScore(const GameState *state);
+void updateSnake(GameState *state);
+bool moveSnake(GameState *state);
+void feedSnake(GameState *state);
+void updateApple(GameState *state);
+bool snakeCollision(const GameState *state, int x, int y, bool excludeHead);
+bool appleCollision(const GameState *state, int x, int y);
+bool cellBlocked(const GameState *state, int x, int y);
+bool wallCollision(const GameState *state, int x, int y);
+unsigned int boardSelect(const Board *board, unsigned int rank);
+void setFood(GameState *state, unsigned int target);
+void emptyFood(GameState *state);
+void startFood(GameState *state);
+bool addFood(GameState *state, int x, int y, FoodKind kind, unsigned long expires);
+const FoodItem *findFood(const GameState *state, int x, int y);
+bool eatFood(GameState *state, int x, int y);
+void updateFood(GameState *state);
+void copyFood(GameState *copy, const GameState *state);
+void freeFood(GameState *state);
+void markDirty(GameState *state, int x, int y);
+void clearDirty(GameState *state);
+/* */
+
+#endif //GAME_H
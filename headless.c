@@ -0,0 +1,94 @@
+/* 
+ * headless.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "game.h"
+#include "level.h"
+#include "bot.h"
+#include "planner.h"
+#include "search.h"
+#include "scores.h"
+#include "headless.h"
+/* */
+
+/* Function responsible of running games back to back with the greedy bot or the autopilot, as fast as the CPU allows.
+ * With a searcher the games move at the pace of its time budget instead */
+void runHeadless(unsigned long ticks, uint64_t seed, int width, int height, const Level *level, unsigned int food,
+                 bool autopilot, Searcher *searcher, ScoreStore *scores, FILE *out) {
+    struct timespec start, end, gameStart, now;
+    unsigned long games = 1, wins = 0;
+    unsigned long long totalScore = 0;
+    int bestScore = 0;
+
+    GameState *state = startGame(width, height, seed);
+    if (level != NULL) {
+        setLevel(state, level);
+        resetGame(state);
+    }
+    if (food > 0) {
+        setFood(state, food);
+        startFood(state);
+    }
+    Planner *planner = autopilot ? startPlanner(state) : NULL;
+    PlayerKind player = searcher != NULL ? PLAYER_SEARCH : autopilot ? PLAYER_AUTOPILOT : PLAYER_BOT;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    gameStart = start;
+    for (unsigned long tick = 0; tick < ticks; tick++) {
+        /* A finished game is recorded and replaced by a new one */
+        if (!state->isAlive) {
+            if (scores != NULL) {
+                ScoreRecord record;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                makeScore(&record, state, seed, games - 1, player,
+                          (now.tv_sec - gameStart.tv_sec) * 1000 + (now.tv_nsec - gameStart.tv_nsec) / 1000000);
+                addScore(scores, &record);
+                gameStart = now;
+            }
+
+            int score = gameScore(state);
+            totalScore += score;
+            if (score > bestScore) bestScore = score;
+            if (state->isWon) wins++;
+            resetGame(state);
+            games++;
+        }
+
+        if (searcher != NULL) stepGame(state, searchInput(searcher, state));
+        else stepGame(state, planner != NULL ? plannerInput(planner, state) : greedyInput(state));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(out, "Simulated %lu ticks in %.3f s: %.0f ticks/sec\n", ticks, elapsed, ticks / elapsed);
+    fprintf(out, "Games: %lu finished, %lu won, best score %d, average score %.1f (seed %llu)\n",
+            games - 1, wins, bestScore, games > 1 ? (double)totalScore / (games - 1) : 0.0, (unsigned long long)seed);
+    if (searcher != NULL) {
+        fprintf(out, "Current game: score %d after %lu ticks\n", gameScore(state), state->ticks);
+        reportSearch(searcher, out);
+    }
+
+    if (planner != NULL) freePlanner(planner);
+    freeGame(state);
+}
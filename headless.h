@@ -0,0 +1,19 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "level.h"
+#include "scores.h"
+#include "search.h"
+
+/* Headless constants */
+#define HEADLESS_TICKS   10000000   /* default number of ticks simulated by --headless */
+/* */
+
+/* Function prototypes */
+void runHeadless(unsigned long ticks, uint64_t seed, int width, int height, const Level *level, unsigned int food,
+                 bool autopilot, Searcher *searcher, ScoreStore *scores, FILE *out);
+/* */
+
+#endif //HEADLESS_H
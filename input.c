@@ -0,0 +1,63 @@
+/* 
+ * input.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdbool.h>
+#include "game.h"
+#include "input.h"
+/* */
+
+/* Direction each turn leads to and the direction it can not follow, indexed by Input */
+static const Direction turnDirection[] = { UP, UP, DOWN, LEFT, RIGHT };
+static const Direction turnOpposite[] = { DOWN, DOWN, UP, RIGHT, LEFT };
+/* */
+
+/* Function responsible of emptying the queue */
+void clearTurns(TurnQueue *queue) {
+    queue->head = 0;
+    queue->count = 0;
+}
+
+/* Function responsible of queueing a turn, returns false when it would be ignored or the queue is full */
+bool queueTurn(TurnQueue *queue, const GameState *state, Input input) {
+    if (input < INPUT_UP || input > INPUT_RIGHT || queue->count == TURN_QUEUE) return false;
+
+    /* Check the turn against the direction the snake will have once the turns before it are applied */
+    Direction direction = state->snake.direction;
+    if (queue->count > 0) {
+        direction = turnDirection[queue->turns[(queue->head + queue->count - 1) % TURN_QUEUE]];
+    }
+    if (turnDirection[input] == direction || turnOpposite[input] == direction) return false;
+
+    queue->turns[(queue->head + queue->count) % TURN_QUEUE] = input;
+    queue->count++;
+    return true;
+}
+
+/* Function responsible of taking the oldest turn, returns false when there is none */
+bool nextTurn(TurnQueue *queue, Input *input) {
+    if (queue->count == 0) return false;
+
+    *input = queue->turns[queue->head];
+    queue->head = (queue->head + 1) % TURN_QUEUE;
+    queue->count--;
+    return true;
+}
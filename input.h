@@ -0,0 +1,23 @@
+#ifndef INPUT_H
+#define INPUT_H
+#include <stdbool.h>
+#include "game.h"
+
+/* Input constants */
+#define TURN_QUEUE       3          /* turns remembered ahead of the snake */
+/* */
+
+/* Queue of turns waiting for their tick, so quick key sequences are not lost */
+typedef struct TurnQueue {
+    Input turns[TURN_QUEUE];
+    unsigned int head;              /* index of the oldest turn */
+    unsigned int count;             /* number of turns waiting */
+} TurnQueue;
+
+/* Function prototypes */
+void clearTurns(TurnQueue *queue);
+bool queueTurn(TurnQueue *queue, const GameState *state, Input input);
+bool nextTurn(TurnQueue *queue, Input *input);
+/* */
+
+#endif //INPUT_H
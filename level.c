@@ -0,0 +1,256 @@
+/* 
+ * level.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/* Libraries */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "level.h"
+/* */
+
+/* Function prototypes for the internal helpers */
+static bool spawnClear(const uint64_t *walls, const Level *level);
+static bool compileRow(Level *level, uint64_t **walls, size_t *capacity, const char *row, size_t length,
+                       unsigned long line, bool *spawned, FILE *out);
+/* */
+
+/* Function returning whether the sides that do not wrap are walls all along, so a snake can never leave through them */
+bool bordersClosed(const uint64_t *walls, int width, int height, uint32_t wrap) {
+    for (int y = 0; !(wrap & LEVEL_WRAP_X) && y < height; y++) {
+        if (!boardTest(walls, (unsigned int)y * width) || !boardTest(walls, (unsigned int)y * width + width - 1)) {
+            return false;
+        }
+    }
+    for (int x = 0; !(wrap & LEVEL_WRAP_Y) && x < width; x++) {
+        if (!boardTest(walls, x) || !boardTest(walls, (unsigned int)(height - 1) * width + x)) return false;
+    }
+    return true;
+}
+
+/* Function responsible of checking a level that came from outside before anything trusts it.
+ * Only the header, the sides and the spawn are looked at, so a big level is checked without reading its walls */
+bool checkLevel(const Level *level, size_t size) {
+    if (size < sizeof(Level) || memcmp(level->magic, LEVEL_MAGIC, 4) != 0) return false;
+    if (level->version != LEVEL_VERSION || level->size != size) return false;
+
+    /* Refuse boards the engine can not play */
+    int width = level->width, height = level->height;
+    if (width < MIN_BOARD_SIZE || width > MAX_BOARD_SIZE || height < MIN_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+        return false;
+    }
+    if (level->direction > RIGHT || level->wrap > (LEVEL_WRAP_X | LEVEL_WRAP_Y)) return false;
+
+    /* The walls follow the header and fill the rest of the file */
+    size_t words = ((size_t)width * height + 63) / 64;
+    if (level->wallsOffset != sizeof(Level) || level->size != sizeof(Level) + words * sizeof(uint64_t)) return false;
+
+    /* The engine indexes the grid with every position, so the snake has to start and stay on the board */
+    if (level->spawnX < 0 || level->spawnX >= width || level->spawnY < 0 || level->spawnY >= height) return false;
+    return bordersClosed(levelWalls(level), width, height, level->wrap) && spawnClear(levelWalls(level), level);
+}
+
+/* Function responsible of compiling a level source into a level file, the mistakes found are written to out.
+ * The source is a grid of LEVEL_WALL and LEVEL_FREE cells, one row per line, with one of ^ v < > on the cell
+ * the snake starts on and facing the way it starts moving. A "wrap x", "wrap y" or "wrap xy" line makes
+ * those sides wrap, and lines starting with LEVEL_COMMENT are skipped */
+bool compileLevel(const char *source, const char *path, FILE *out) {
+    FILE *file = fopen(source, "r");
+    if (file == NULL) {
+        fprintf(out, "ERROR: Could not read the level source '%s'.\n", source);
+        return false;
+    }
+
+    Level level;
+    memset(&level, 0, sizeof(Level));
+    memcpy(level.magic, LEVEL_MAGIC, 4);
+    level.version = LEVEL_VERSION;
+    level.direction = UP;
+
+    uint64_t *walls = NULL;
+    size_t capacity = 0;
+    char *row = NULL;
+    size_t rowCapacity = 0;
+    ssize_t length;
+    unsigned long line = 0;
+    bool spawned = false, valid = true;
+    while (valid && (length = getline(&row, &rowCapacity, file)) >= 0) {
+        line++;
+        while (length > 0 && (row[length - 1] == '\n' || row[length - 1] == '\r')) row[--length] = '\0';
+        if (length == 0 || row[0] == LEVEL_COMMENT) continue;
+
+        /* Directives are words, rows never hold letters */
+        if (strncmp(row, "wrap", 4) == 0) {
+            for (const char *side = row + 4; valid && *side != '\0'; side++) {
+                if (*side == 'x') level.wrap |= LEVEL_WRAP_X;
+                else if (*side == 'y') level.wrap |= LEVEL_WRAP_Y;
+                else if (*side != ' ') valid = false;
+            }
+            if (!valid) fprintf(out, "ERROR: line %lu: Only the x and y sides can wrap.\n", line);
+            continue;
+        }
+
+        valid = compileRow(&level, &walls, &capacity, row, length, line, &spawned, out);
+    }
+    free(row);
+    fclose(file);
+
+    /* The whole board is known, it still has to be one the engine can play */
+    if (valid && (level.width < MIN_BOARD_SIZE || level.height < MIN_BOARD_SIZE)) {
+        fprintf(out, "ERROR: The level is %dx%d, its sides must be at least %d.\n", level.width, level.height,
+                MIN_BOARD_SIZE);
+        valid = false;
+    }
+    if (valid && !spawned) {
+        /* Without a spawn the snake starts like on the empty box, going up from the center */
+        level.spawnX = level.width / 2;
+        level.spawnY = level.height / 2;
+    }
+    if (valid && !bordersClosed(walls, level.width, level.height, level.wrap)) {
+        fprintf(out, "ERROR: The sides that do not wrap must be walls all along.\n");
+        valid = false;
+    }
+    if (valid && !spawnClear(walls, &level)) {
+        fprintf(out, "ERROR: The %d cells from the spawn back must be free for the starting snake.\n", START_SNAKE_SIZE);
+        valid = false;
+    }
+
+    /* The header is followed by the walls exactly as the board holds them */
+    if (valid) {
+        size_t words = ((size_t)level.width * level.height + 63) / 64;
+        level.wallsOffset = sizeof(Level);
+        level.size = sizeof(Level) + words * sizeof(uint64_t);
+
+        FILE *output = fopen(path, "wb");
+        valid = output != NULL && fwrite(&level, sizeof(Level), 1, output) == 1 &&
+                fwrite(walls, sizeof(uint64_t), words, output) == words;
+        if (output != NULL && fclose(output) != 0) valid = false;
+        if (!valid) fprintf(out, "ERROR: Could not write the level '%s'.\n", path);
+    }
+
+    free(walls);
+    return valid;
+}
+
+/* Function responsible of mapping a level file, pages are only read as games are built on it */
+const Level *mapLevel(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Level)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* The mapping stays valid once the descriptor is closed */
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    if (!checkLevel(data, info.st_size)) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+    return data;
+}
+
+/* Function responsible of unmapping a level mapped with mapLevel */
+void unmapLevel(const Level *level) {
+    munmap((void *)level, level->size);
+}
+
+/* Function returning whether the starting snake fits behind the spawn, on free cells and through the wrapping sides */
+static bool spawnClear(const uint64_t *walls, const Level *level) {
+    Board board = { .width = level->width, .height = level->height,
+                    .wrapX = level->wrap & LEVEL_WRAP_X, .wrapY = level->wrap & LEVEL_WRAP_Y };
+    int dx = level->direction == LEFT ? -1 : level->direction == RIGHT ? 1 : 0;
+    int dy = level->direction == UP ? -1 : level->direction == DOWN ? 1 : 0;
+
+    for (int i = 0; i < START_SNAKE_SIZE; i++) {
+        int x = level->spawnX - i * dx, y = level->spawnY - i * dy;
+        wrapCell(&board, &x, &y);
+        if (x < 0 || y < 0 || x >= board.width || y >= board.height) return false;
+        if (boardTest(walls, boardCell(&board, x, y))) return false;
+    }
+    return true;
+}
+
+/* Function responsible of adding a row of a level source to the walls, returns false after reporting a mistake */
+static bool compileRow(Level *level, uint64_t **walls, size_t *capacity, const char *row, size_t length,
+                       unsigned long line, bool *spawned, FILE *out) {
+    /* The first row decides the width, the others have to match it */
+    if (length > MAX_BOARD_SIZE || level->height == MAX_BOARD_SIZE) {
+        fprintf(out, "ERROR: line %lu: The level sides can not be longer than %d.\n", line, MAX_BOARD_SIZE);
+        return false;
+    }
+    if (level->height == 0) level->width = length;
+    if (length != (size_t)level->width) {
+        fprintf(out, "ERROR: line %lu: The row has %zu cells, the first one has %d.\n", line, length, level->width);
+        return false;
+    }
+
+    /* Grow the walls by doubling, a big level is not copied over once per row */
+    size_t words = ((size_t)(level->height + 1) * level->width + 63) / 64;
+    if (words > *capacity) {
+        size_t grown = *capacity * 2 > words ? *capacity * 2 : words;
+        *walls = realloc(*walls, grown * sizeof(uint64_t));
+        memset(*walls + *capacity, 0, (grown - *capacity) * sizeof(uint64_t));
+        *capacity = grown;
+    }
+
+    for (int x = 0; x < level->width; x++) {
+        unsigned int cell = (unsigned int)level->height * level->width + x;
+        Direction direction;
+        switch (row[x]) {
+            case LEVEL_WALL: boardSet(*walls, cell); continue;
+            case LEVEL_FREE: continue;
+            case '^':        direction = UP; break;
+            case 'v':        direction = DOWN; break;
+            case '<':        direction = LEFT; break;
+            case '>':        direction = RIGHT; break;
+            default:
+                fprintf(out, "ERROR: line %lu: Unknown cell '%c' in column %d.\n", line, row[x], x + 1);
+                return false;
+        }
+
+        /* Only one snake starts on the board */
+        if (*spawned) {
+            fprintf(out, "ERROR: line %lu: A second spawn in column %d, there can only be one.\n", line, x + 1);
+            return false;
+        }
+        *spawned = true;
+        level->spawnX = x;
+        level->spawnY = level->height;
+        level->direction = direction;
+    }
+
+    level->height++;
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "game.h"
+
+/* Level constants */
+#define LEVEL_MAGIC      "SLVL"     /* first bytes of every level file */
+#define LEVEL_VERSION    1          /* layout version, bumped whenever the layout changes */
+#define LEVEL_WRAP_X     1          /* the left and right sides wrap */
+#define LEVEL_WRAP_Y     2          /* the top and bottom sides wrap */
+#define LEVEL_WALL       '#'        /* wall cell in a level source */
+#define LEVEL_FREE       '.'        /* free cell in a level source */
+#define LEVEL_COMMENT    ';'        /* lines starting with it are skipped */
+/* */
+
+/* Level structure, the header of a level file with the walls right after it.
+ * Like a snapshot the walls are found through an offset, and they are one bit per cell in the layout
+ * of the board's grid, so a mapped level is used as is and starting a game is a copy of them.
+ * Numbers are in the byte order of the machine that compiled it */
+typedef struct Level {
+    char magic[4];
+    uint32_t version;
+    uint64_t size;                  /* bytes in the file, header included */
+    int32_t width, height;          /* board dimensions, borders included */
+    int32_t spawnX, spawnY;         /* head of the starting snake, its body trails behind it */
+    uint32_t direction;             /* direction the snake starts moving in */
+    uint32_t wrap;                  /* LEVEL_WRAP_X and LEVEL_WRAP_Y, sides that do not wrap are walls */
+    uint64_t wallsOffset;
+} Level;
+
+/* Walls of a level, in the layout of Board.walls */
+static inline const uint64_t *levelWalls(const Level *level) {
+    return (const uint64_t *)((const uint8_t *)level + level->wallsOffset);
+}
+
+/* Function prototypes */
+bool bordersClosed(const uint64_t *walls, int width, int height, uint32_t wrap);
+bool checkLevel(const Level *level, size_t size);
+bool compileLevel(const char *source, const char *path, FILE *out);
+const Level *mapLevel(const char *path);
+void unmapLevel(const Level *level);
+/* */
+
+#endif //LEVEL_H
@@ -0,0 +1,208 @@
+/* 
+ * libserpent.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "libserpent.h"
+/* */
+
+/* Environment set structure, one game per environment and the caller's buffers */
+struct SerpentEnv {
+    uint32_t count;
+    int width, height;
+    size_t cells;
+    GameState **games;
+    unsigned long *lastMeal;        /* tick of the last apple of every environment */
+    float *observations;
+    float *rewards;
+    uint8_t *dones;
+};
+
+/* Function prototypes for the internal helpers */
+static void observeGame(SerpentEnv *env, uint32_t index);
+static void observeChanges(SerpentEnv *env, uint32_t index);
+static void observeBody(SerpentEnv *env, uint32_t index);
+/* */
+
+/* Function returning the ABI version the library was built with */
+uint32_t serpentVersion(void) {
+    return SERPENT_ABI_VERSION;
+}
+
+/* Function responsible of allocating a set of environments, NULL when the board size can not be played */
+SerpentEnv *serpentOpen(uint32_t envs, int32_t width, int32_t height) {
+    if (envs == 0 || width < MIN_BOARD_SIZE || width > MAX_BOARD_SIZE ||
+        height < MIN_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+        return NULL;
+    }
+
+    SerpentEnv *env = calloc(1, sizeof(SerpentEnv));
+    env->count = envs;
+    env->width = width;
+    env->height = height;
+    env->cells = (size_t)width * height;
+    env->games = malloc(envs * sizeof(GameState *));
+    env->lastMeal = calloc(envs, sizeof(unsigned long));
+    for (uint32_t i = 0; i < envs; i++) env->games[i] = startGame(width, height, 0);
+    return env;
+}
+
+/* Function returning the floats in the observation of a single environment */
+size_t serpentObservationSize(const SerpentEnv *env) {
+    return SERPENT_PLANES * env->cells;
+}
+
+/* Function responsible of handing the library the buffers every later call writes to, and filling them in */
+void serpentBind(SerpentEnv *env, float *observations, float *rewards, uint8_t *dones) {
+    env->observations = observations;
+    env->rewards = rewards;
+    env->dones = dones;
+    for (uint32_t i = 0; i < env->count; i++) observeGame(env, i);
+}
+
+/* Function responsible of starting a new episode in every environment, environment i uses stream i of the seed */
+void serpentReset(SerpentEnv *env, uint64_t seed) {
+    for (uint32_t i = 0; i < env->count; i++) {
+        seedGame(env->games[i], seed, i);
+        resetGame(env->games[i]);
+        env->lastMeal[i] = 0;
+        if (env->rewards != NULL) env->rewards[i] = 0.0f;
+        if (env->dones != NULL) env->dones[i] = 0;
+        observeGame(env, i);
+    }
+}
+
+/* Function responsible of stepping the first n environments with one action each.
+ * The move is the one of updateSnake, split so the reward knows whether the apple was eaten */
+void serpentStep(SerpentEnv *env, const int32_t *actions, uint32_t n) {
+    if (n > env->count) n = env->count;
+
+    for (uint32_t i = 0; i < n; i++) {
+        GameState *state = env->games[i];
+        float reward = 0.0f;
+        bool done = false;
+
+        /* Pausing is not an action, it would only waste a step */
+        Input input = actions[i] >= INPUT_NONE && actions[i] <= INPUT_RIGHT ? (Input)actions[i] : INPUT_NONE;
+        clearDirty(state);
+        applyInput(state, input);
+        if (moveSnake(state)) {
+            feedSnake(state);
+            env->lastMeal[i] = state->ticks;
+            reward = 1.0f;
+        }
+
+        /* A won game is not a crash, a bot circling forever is cut short */
+        if (!state->isAlive) {
+            if (!state->isWon) reward = -1.0f;
+            done = true;
+        } else if (state->ticks - env->lastMeal[i] > SERPENT_STARVATION * env->cells) {
+            done = true;
+        }
+
+        if (env->rewards != NULL) env->rewards[i] = reward;
+        if (env->dones != NULL) env->dones[i] = done;
+
+        /* The next episode starts from the game's own stream, so a whole run is decided by the reset seed */
+        if (done) {
+            resetGame(state);
+            env->lastMeal[i] = 0;
+            observeGame(env, i);
+        } else {
+            observeChanges(env, i);
+        }
+    }
+}
+
+/* Function responsible of writing the score of every environment's current episode */
+void serpentScores(const SerpentEnv *env, int32_t *scores) {
+    for (uint32_t i = 0; i < env->count; i++) scores[i] = gameScore(env->games[i]);
+}
+
+/* Function responsible of freeing a set of environments, the caller's buffers are left alone */
+void serpentClose(SerpentEnv *env) {
+    for (uint32_t i = 0; i < env->count; i++) freeGame(env->games[i]);
+    free(env->games);
+    free(env->lastMeal);
+    free(env);
+}
+
+/* Function responsible of writing the whole observation of an environment */
+static void observeGame(SerpentEnv *env, uint32_t index) {
+    if (env->observations == NULL) return;
+
+    const GameState *state = env->games[index];
+    float *planes = env->observations + index * serpentObservationSize(env);
+    memset(planes, 0, serpentObservationSize(env) * sizeof(float));
+
+    float *walls = planes + SERPENT_PLANE_WALLS * env->cells;
+    for (size_t cell = 0; cell < env->cells; cell++) {
+        if (boardTest(state->board.walls, cell)) walls[cell] = 1.0f;
+    }
+
+    const Position *head = snakeSegment(state, 0);
+    planes[SERPENT_PLANE_HEAD * env->cells + (size_t)head->pY * env->width + head->pX] = 1.0f;
+    if (state->apple.pX >= 0) {
+        planes[SERPENT_PLANE_APPLE * env->cells + (size_t)state->apple.pY * env->width + state->apple.pX] = 1.0f;
+    }
+    observeBody(env, index);
+}
+
+/* Function responsible of updating the observation after a step, only the cells the step changed are visited,
+ * and the body, whose every segment got older */
+static void observeChanges(SerpentEnv *env, uint32_t index) {
+    if (env->observations == NULL) return;
+
+    GameState *state = env->games[index];
+    if (state->dirtyOverflow) {
+        observeGame(env, index);
+        return;
+    }
+
+    float *planes = env->observations + index * serpentObservationSize(env);
+    const Position *head = snakeSegment(state, 0);
+    for (unsigned int i = 0; i < state->dirtyCount; i++) {
+        int x = state->dirtyCells[i].pX, y = state->dirtyCells[i].pY;
+        size_t cell = (size_t)y * env->width + x;
+        planes[SERPENT_PLANE_BODY * env->cells + cell] = 0.0f;
+        planes[SERPENT_PLANE_HEAD * env->cells + cell] = head->pX == x && head->pY == y;
+        planes[SERPENT_PLANE_APPLE * env->cells + cell] = appleCollision(state, x, y);
+    }
+    observeBody(env, index);
+}
+
+/* Function responsible of writing the age of every segment, walking the ring buffer from the head */
+static void observeBody(SerpentEnv *env, uint32_t index) {
+    const GameState *state = env->games[index];
+    const Snake *snake = &state->snake;
+    float *body = env->observations + index * serpentObservationSize(env) + SERPENT_PLANE_BODY * env->cells;
+    float step = 1.0f / snake->length;
+
+    unsigned int pos = snake->head;
+    for (unsigned int i = 0; i < snake->length; i++) {
+        body[(size_t)snake->body[pos].pY * env->width + snake->body[pos].pX] = (snake->length - i) * step;
+        if (++pos == snake->capacity) pos = 0;
+    }
+}
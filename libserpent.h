@@ -0,0 +1,38 @@
+#ifndef LIBSERPENT_H
+#define LIBSERPENT_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* Library constants, part of the ABI */
+#define SERPENT_ABI_VERSION 1       /* bumped whenever a function or the buffer layout changes */
+#define SERPENT_PLANE_WALLS 0       /* 1 on the walls */
+#define SERPENT_PLANE_BODY  1       /* from 1 on the head down to 1 / length on the tail, 0 elsewhere */
+#define SERPENT_PLANE_HEAD  2       /* 1 on the head */
+#define SERPENT_PLANE_APPLE 3       /* 1 on the apple */
+#define SERPENT_PLANES      4       /* planes in each observation */
+#define SERPENT_STARVATION  4       /* boards worth of moves without eating before an episode is cut short */
+/* */
+
+/* Symbols exported by libserpent.so, everything else stays inside the library */
+#define SERPENT_API __attribute__((visibility("default")))
+
+/* A set of environments stepped together, only used through the functions below */
+typedef struct SerpentEnv SerpentEnv;
+
+/* Function prototypes.
+ * Buffers belong to the caller and are written in place, so NumPy arrays can be passed as they are:
+ * observations are float32 [envs][SERPENT_PLANES][height][width], rewards float32 [envs] and dones uint8 [envs].
+ * Actions are int32 [envs]: 0 keeps going, 1 up, 2 down, 3 left, 4 right, anything else keeps going.
+ * Rewards are 1 for an apple, -1 for a crash and 0 otherwise. A finished episode sets its done flag and
+ * the environment starts its next episode right away, its observation is already the new one */
+SERPENT_API uint32_t serpentVersion(void);
+SERPENT_API SerpentEnv *serpentOpen(uint32_t envs, int32_t width, int32_t height);
+SERPENT_API size_t serpentObservationSize(const SerpentEnv *env);
+SERPENT_API void serpentBind(SerpentEnv *env, float *observations, float *rewards, uint8_t *dones);
+SERPENT_API void serpentReset(SerpentEnv *env, uint64_t seed);
+SERPENT_API void serpentStep(SerpentEnv *env, const int32_t *actions, uint32_t n);
+SERPENT_API void serpentScores(const SerpentEnv *env, int32_t *scores);
+SERPENT_API void serpentClose(SerpentEnv *env);
+/* */
+
+#endif //LIBSERPENT_H
@@ -0,0 +1,449 @@
+/* 
+ * planner.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "regions.h"
+#include "planner.h"
+/* */
+
+/* Movement of each direction, indexed by Direction */
+static const int moveX[] = { 0, 0, -1, 1 };
+static const int moveY[] = { -1, 1, 0, 0 };
+static const Input turnInput[] = { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT };
+static const Direction opposite[] = { DOWN, UP, RIGHT, LEFT };
+/* */
+
+/* Function prototypes for the internal helpers */
+static void computeField(Planner *planner, const GameState *state);
+static void markBody(Planner *planner, const GameState *state);
+static bool planPath(Planner *planner, const GameState *state);
+static bool tailReachable(Planner *planner, const GameState *state, bool eats);
+static Input followPlan(Planner *planner, const GameState *state);
+static Input chaseTail(Planner *planner, const GameState *state);
+static bool searchApple(Planner *planner, const GameState *state);
+static bool searchCell(Planner *planner, const GameState *state, unsigned int start, unsigned int startTime,
+                       unsigned int target);
+static void writePath(Planner *planner, const GameState *state, unsigned int start, unsigned int target,
+                      unsigned int offset);
+/* */
+
+/* Heap helpers, the key holds the estimated length in the high half and the cell in the low half */
+static void heapPush(Planner *planner, uint64_t key) {
+    if (planner->heapSize == planner->heapCapacity) {
+        planner->heapCapacity *= 2;
+        planner->heap = realloc(planner->heap, planner->heapCapacity * sizeof(uint64_t));
+    }
+
+    size_t i = planner->heapSize++;
+    while (i > 0 && planner->heap[(i - 1) / 2] > key) {
+        planner->heap[i] = planner->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    planner->heap[i] = key;
+}
+
+static uint64_t heapPop(Planner *planner) {
+    uint64_t top = planner->heap[0];
+    uint64_t last = planner->heap[--planner->heapSize];
+    size_t i = 0;
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= planner->heapSize) break;
+        if (child + 1 < planner->heapSize && planner->heap[child + 1] < planner->heap[child]) child++;
+        if (planner->heap[child] >= last) break;
+        planner->heap[i] = planner->heap[child];
+        i = child;
+    }
+    planner->heap[i] = last;
+    return top;
+}
+/* */
+
+/* Function responsible of allocating a planner for the board of the given game */
+Planner *startPlanner(const GameState *state) {
+    Planner *planner = calloc(1, sizeof(Planner));
+    size_t cells = (size_t)state->board.width * state->board.height;
+
+    planner->width = state->board.width;
+    planner->height = state->board.height;
+    planner->field = malloc(cells * sizeof(uint32_t));
+    planner->freeAt = malloc(cells * sizeof(uint32_t));
+    planner->bodyMark = calloc(cells, sizeof(uint32_t));
+    planner->cost = malloc(cells * sizeof(uint32_t));
+    planner->seenMark = calloc(cells, sizeof(uint32_t));
+    planner->from = malloc(cells);
+    planner->queue = malloc(cells * sizeof(uint32_t));
+    planner->heapCapacity = cells;
+    planner->heap = malloc(planner->heapCapacity * sizeof(uint64_t));
+    planner->path = malloc(cells);
+
+    planner->regions = startRegions(state);
+
+    /* No field yet, the first decision computes it */
+    planner->fieldX = -1;
+    planner->fieldY = -1;
+    return planner;
+}
+
+/* Function responsible of picking the next move: the planned path when it still holds, a new plan otherwise,
+ * and chasing the tail when the apple can not be reached safely */
+Input plannerInput(Planner *planner, const GameState *state) {
+    Position *head = snakeSegment(state, 0);
+    syncRegions(planner->regions, state);
+
+    /* Remember when the snake last ate, a new game counts as a meal */
+    if (snakeSize(state) != planner->lastLength || state->ticks < planner->lastMeal) {
+        planner->lastLength = snakeSize(state);
+        planner->lastMeal = state->ticks;
+    }
+
+    /* Nothing changed that the plan did not expect, so nothing has to be searched again */
+    if (planner->pathStep < planner->pathLength && head->pX == planner->expectX && head->pY == planner->expectY &&
+        state->ticks == planner->expectTicks && state->apple.pX == planner->fieldX && state->apple.pY == planner->fieldY &&
+        snakeSize(state) == planner->expectLength && state->snake.growth == planner->expectGrowth) {
+        return followPlan(planner, state);
+    }
+
+    if (planPath(planner, state)) return followPlan(planner, state);
+
+    return chaseTail(planner, state);
+}
+
+/* Function responsible of freeing a planner */
+void freePlanner(Planner *planner) {
+    free(planner->field);
+    free(planner->freeAt);
+    free(planner->bodyMark);
+    free(planner->cost);
+    free(planner->seenMark);
+    free(planner->from);
+    free(planner->queue);
+    free(planner->heap);
+    free(planner->path);
+    freeRegions(planner->regions);
+    free(planner);
+}
+
+/* Function responsible of taking the next step of the plan */
+static Input followPlan(Planner *planner, const GameState *state) {
+    Position *head = snakeSegment(state, 0);
+    Direction direction = planner->path[planner->pathStep++];
+
+    int x = head->pX + moveX[direction], y = head->pY + moveY[direction];
+    wrapCell(&state->board, &x, &y);
+    planner->expectX = x;
+    planner->expectY = y;
+    planner->expectTicks = state->ticks + 1;
+
+    /* The tail follows unless growth is left, a food item eaten on the way breaks the plan's view of the body */
+    planner->expectLength = snakeSize(state) + (state->snake.growth > 0);
+    planner->expectGrowth = state->snake.growth - (state->snake.growth > 0);
+    return turnInput[direction];
+}
+
+/* Function responsible of computing the distance from every cell to the apple, only walls are in the way.
+ * It only changes when the apple moves, so it is computed once per apple and not once per move */
+static void computeField(Planner *planner, const GameState *state) {
+    size_t cells = (size_t)planner->width * planner->height;
+    unsigned int head = 0, tail = 0;
+
+    for (size_t i = 0; i < cells; i++) planner->field[i] = PLAN_UNREACHABLE;
+    planner->fieldX = state->apple.pX;
+    planner->fieldY = state->apple.pY;
+    if (state->apple.pX < 0) return;
+
+    unsigned int apple = (unsigned int)state->apple.pY * planner->width + state->apple.pX;
+    planner->field[apple] = 0;
+    planner->queue[tail++] = apple;
+
+    while (head < tail) {
+        unsigned int cell = planner->queue[head++];
+        int x = cell % planner->width, y = cell / planner->width;
+
+        for (int d = UP; d <= RIGHT; d++) {
+            int nx = x + moveX[d], ny = y + moveY[d];
+            wrapCell(&state->board, &nx, &ny);
+            if (wallCollision(state, nx, ny)) continue;
+
+            unsigned int next = (unsigned int)ny * planner->width + nx;
+            if (planner->field[next] != PLAN_UNREACHABLE) continue;
+            planner->field[next] = planner->field[cell] + 1;
+            planner->queue[tail++] = next;
+        }
+    }
+}
+
+/* Function responsible of marking, for every body cell, the move after which the body leaves it */
+static void markBody(Planner *planner, const GameState *state) {
+    unsigned int length = snakeSize(state);
+    planner->bodyGeneration++;
+
+    /* Segment i leaves once the tail has moved past it, which waits for the pending growth */
+    for (unsigned int i = 0; i < length; i++) {
+        Position *segment = snakeSegment(state, i);
+        unsigned int cell = (unsigned int)segment->pY * planner->width + segment->pX;
+        planner->freeAt[cell] = length - i + state->snake.growth;
+        planner->bodyMark[cell] = planner->bodyGeneration;
+    }
+}
+
+/* Function responsible of checking if the snake can enter a cell after the given number of moves */
+static inline bool cellOpen(const Planner *planner, const GameState *state, int x, int y, unsigned int time) {
+    if (wallCollision(state, x, y)) return false;
+
+    /* A body cell can only be entered once the tail went past it */
+    unsigned int cell = (unsigned int)y * planner->width + x;
+    return planner->bodyMark[cell] != planner->bodyGeneration || planner->freeAt[cell] <= time;
+}
+
+/* Function responsible of the A* search from the head to the apple over the marked body,
+ * the field is an exact heuristic until the body gets in the way so few cells are expanded */
+static bool searchApple(Planner *planner, const GameState *state) {
+    Position *head = snakeSegment(state, 0);
+    unsigned int start = (unsigned int)head->pY * planner->width + head->pX;
+    unsigned int apple = (unsigned int)state->apple.pY * planner->width + state->apple.pX;
+
+    planner->seenGeneration++;
+    planner->heapSize = 0;
+    planner->cost[start] = 0;
+    planner->seenMark[start] = planner->seenGeneration;
+    heapPush(planner, (uint64_t)planner->field[start] << 32 | start);
+
+    while (planner->heapSize > 0) {
+        uint64_t key = heapPop(planner);
+        unsigned int cell = (uint32_t)key;
+        unsigned int time = planner->cost[cell];
+
+        /* Skip the stale copies of cells that were reached again with a shorter path */
+        if ((key >> 32) != time + planner->field[cell]) continue;
+        if (cell == apple) return true;
+
+        int x = cell % planner->width, y = cell / planner->width;
+        for (int d = UP; d <= RIGHT; d++) {
+            int nx = x + moveX[d], ny = y + moveY[d];
+            wrapCell(&state->board, &nx, &ny);
+            if (!cellOpen(planner, state, nx, ny, time + 1)) continue;
+
+            unsigned int next = (unsigned int)ny * planner->width + nx;
+            if (planner->field[next] == PLAN_UNREACHABLE) continue;
+            if (planner->seenMark[next] == planner->seenGeneration && planner->cost[next] <= time + 1) continue;
+
+            planner->seenMark[next] = planner->seenGeneration;
+            planner->cost[next] = time + 1;
+            planner->from[next] = d;
+            heapPush(planner, (uint64_t)(time + 1 + planner->field[next]) << 32 | next);
+        }
+    }
+
+    return false;
+}
+
+/* Function responsible of a breadth-first search over the marked body, starting after startTime moves.
+ * Returns whether the target was reached */
+static bool searchCell(Planner *planner, const GameState *state, unsigned int start, unsigned int startTime,
+                       unsigned int target) {
+    unsigned int head = 0, tail = 0;
+
+    planner->seenGeneration++;
+    planner->cost[start] = startTime;
+    planner->seenMark[start] = planner->seenGeneration;
+    planner->queue[tail++] = start;
+
+    /* Every move costs the same, so cells leave the queue in the order of the move they are reached on */
+    while (head < tail) {
+        unsigned int cell = planner->queue[head++];
+        unsigned int time = planner->cost[cell];
+        if (cell == target) return true;
+
+        int x = cell % planner->width, y = cell / planner->width;
+        for (int d = UP; d <= RIGHT; d++) {
+            int nx = x + moveX[d], ny = y + moveY[d];
+            wrapCell(&state->board, &nx, &ny);
+            if (!cellOpen(planner, state, nx, ny, time + 1)) continue;
+            unsigned int next = (unsigned int)ny * planner->width + nx;
+            if (planner->seenMark[next] == planner->seenGeneration) continue;
+
+            planner->seenMark[next] = planner->seenGeneration;
+            planner->cost[next] = time + 1;
+            planner->from[next] = d;
+            planner->queue[tail++] = next;
+        }
+    }
+
+    return false;
+}
+
+/* Function responsible of writing down the directions of the last search, walking back from the target */
+static void writePath(Planner *planner, const GameState *state, unsigned int start, unsigned int target,
+                      unsigned int offset) {
+    unsigned int cell = target;
+
+    for (unsigned int i = offset + planner->cost[target] - planner->cost[start]; i-- > offset; ) {
+        Direction direction = planner->from[cell];
+        planner->path[i] = direction;
+        int x = (int)(cell % planner->width) - moveX[direction], y = (int)(cell / planner->width) - moveY[direction];
+        wrapCell(&state->board, &x, &y);
+        cell = (unsigned int)y * planner->width + x;
+    }
+
+    planner->pathLength = offset + planner->cost[target] - planner->cost[start];
+    planner->pathStep = 0;
+}
+
+/* Function responsible of planning a path to the apple that leaves the snake a way out, returns whether it found one */
+static bool planPath(Planner *planner, const GameState *state) {
+    /* The field only needs to be computed again when the apple moved */
+    if (state->apple.pX != planner->fieldX || state->apple.pY != planner->fieldY) computeField(planner, state);
+    if (state->apple.pX < 0) return false;
+
+    Position *head = snakeSegment(state, 0);
+    unsigned int apple = (unsigned int)state->apple.pY * planner->width + state->apple.pX;
+    if (planner->field[(unsigned int)head->pY * planner->width + head->pX] == PLAN_UNREACHABLE) return false;
+
+    markBody(planner, state);
+    if (!searchApple(planner, state)) return false;
+    writePath(planner, state, (unsigned int)head->pY * planner->width + head->pX, apple, 0);
+
+    /* Only take the path if the snake can still reach its tail once it ate the apple,
+     * unless it went so long without eating that it is better to risk it than to loop forever */
+    bool starving = state->ticks - planner->lastMeal >= (unsigned long)planner->width * planner->height;
+    if (!starving && !tailReachable(planner, state, true)) {
+        planner->pathLength = 0;
+        return false;
+    }
+
+    return true;
+}
+
+/* Function responsible of checking that, once the planned path is followed, the head can still reach the tail.
+ * Food items on the path hold the tail back like the apple does, so the walk also checks that every body cell
+ * the path enters was left by the tail in time, the marks of markBody only know the growth pending already */
+static bool tailReachable(Planner *planner, const GameState *state, bool eats) {
+    Position *head = snakeSegment(state, 0);
+    unsigned int moves = planner->pathLength;
+    unsigned int length = snakeSize(state);
+    unsigned int growth = state->snake.growth;
+    unsigned int pops = 0;
+
+    /* Walk the path as moveSnake would: the tail stays put on every move that eats and while growth is left */
+    int endX = head->pX, endY = head->pY;
+    for (unsigned int i = 0; i < moves; i++) {
+        endX += moveX[planner->path[i]];
+        endY += moveY[planner->path[i]];
+        wrapCell(&state->board, &endX, &endY);
+
+        const FoodItem *item = findFood(state, endX, endY);
+        bool apple = eats && i == moves - 1;
+        if (apple || item != NULL) {
+            growth += apple + (item != NULL ? 1 + (item->kind == FOOD_BONUS ? FOOD_BONUS_GROWTH : 0) : 0);
+        } else if (growth > 0) {
+            growth--;
+        } else {
+            pops++;
+        }
+
+        unsigned int cell = (unsigned int)endY * planner->width + endX;
+        if (planner->bodyMark[cell] == planner->bodyGeneration &&
+            planner->freeAt[cell] - state->snake.growth > pops) {
+            return false;
+        }
+    }
+    unsigned int newLength = length + moves - pops;
+
+    /* The snake after the path is the path walked backwards from its end, followed by the old body */
+    planner->bodyGeneration++;
+    int x = endX, y = endY;
+    for (unsigned int i = 0; i < newLength; i++) {
+        if (i > 0 && i <= moves) {
+            Direction direction = planner->path[moves - i];
+            x -= moveX[direction];
+            y -= moveY[direction];
+            wrapCell(&state->board, &x, &y);
+        } else if (i > moves) {
+            Position *segment = snakeSegment(state, i - moves);
+            x = segment->pX;
+            y = segment->pY;
+        }
+
+        unsigned int cell = (unsigned int)y * planner->width + x;
+        planner->freeAt[cell] = newLength - i + growth;
+        planner->bodyMark[cell] = planner->bodyGeneration;
+    }
+
+    unsigned int end = (unsigned int)endY * planner->width + endX;
+    return searchCell(planner, state, end, 0, (unsigned int)y * planner->width + x);
+}
+
+/* Function responsible of stalling when the apple is out of reach: take the move with the longest way to the tail,
+ * or the one with the most room when the tail is lost, read from the regions instead of a flood fill.
+ * The way to the tail becomes the plan, as following it keeps the tail reachable,
+ * so the apple is only looked for again once it is walked */
+static Input chaseTail(Planner *planner, const GameState *state) {
+    Position *head = snakeSegment(state, 0);
+    Position *tailSegment = snakeSegment(state, snakeSize(state) - 1);
+    unsigned int tail = (unsigned int)tailSegment->pY * planner->width + tailSegment->pX;
+    long long bestScore = -1;
+    int best = -1;
+
+    markBody(planner, state);
+    for (int d = UP; d <= RIGHT; d++) {
+        if (d == (int)opposite[state->snake.direction]) continue;
+
+        /* The first move has to be legal right away */
+        int x = head->pX + moveX[d], y = head->pY + moveY[d];
+        wrapCell(&state->board, &x, &y);
+        if (!cellOpen(planner, state, x, y, 1)) continue;
+
+        MoveRoom room;
+        unsigned int cell = (unsigned int)y * planner->width + x;
+        bool reached = searchCell(planner, state, cell, 1, tail);
+        if (!reached && !probeMove(planner->regions, state, d, &room)) continue;
+        long long score = reached ? (1LL << 40) + planner->cost[tail] : room.room;
+
+        if (score > bestScore) {
+            bestScore = score;
+            best = d;
+        }
+    }
+
+    /* When every move is deadly keep going, the game is over anyway */
+    if (best < 0) return INPUT_NONE;
+
+    /* Search the chosen way to the tail again, the other candidates overwrote it. Walking over cells the tail
+     * just left can still cut the snake off, so the whole way is only kept if the tail is in reach at its end */
+    int x = head->pX + moveX[best], y = head->pY + moveY[best];
+    wrapCell(&state->board, &x, &y);
+    unsigned int cell = (unsigned int)y * planner->width + x;
+    planner->path[0] = best;
+    planner->pathLength = 1;
+    planner->pathStep = 0;
+    if (bestScore >= (1LL << 40) && searchCell(planner, state, cell, 1, tail)) {
+        writePath(planner, state, cell, tail, 1);
+        if (!tailReachable(planner, state, false)) planner->pathLength = 1;
+    }
+
+    return followPlan(planner, state);
+}
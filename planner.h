@@ -0,0 +1,44 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "regions.h"
+
+/* Planner constants */
+#define PLAN_UNREACHABLE UINT32_MAX /* distance of the cells that can not reach the apple */
+/* */
+
+/* Planner structure, the search memory of one board plus the plan being followed */
+typedef struct Planner {
+    int width, height;
+    uint32_t *field;                /* distance from each cell to the apple around the walls, the A* heuristic */
+    int fieldX, fieldY;             /* apple the field was computed for */
+    uint32_t *freeAt;               /* move after which the body leaves a cell, when bodyMark is current */
+    uint32_t *bodyMark;
+    uint32_t *cost;                 /* moves needed to reach a cell in the last search, when seenMark is current */
+    uint32_t *seenMark;
+    uint8_t *from;                  /* direction the last search entered each cell with */
+    uint32_t bodyGeneration;        /* bumping these forgets every mark without clearing the arrays */
+    uint32_t seenGeneration;
+    uint32_t *queue;                /* cells waiting in the field's breadth-first search */
+    uint64_t *heap;                 /* open cells of the A* search, keyed by estimated length */
+    size_t heapSize, heapCapacity;
+    uint8_t *path;                  /* directions from the head to the apple */
+    unsigned int pathLength, pathStep;
+    int expectX, expectY;           /* where the head has to be for the plan to still hold */
+    unsigned long expectTicks;
+    int expectLength;               /* length and growth the snake has after that move when it eats nothing */
+    unsigned int expectGrowth;
+    int lastLength;                 /* length of the snake when it last ate, as snakeSize gives it */
+    unsigned long lastMeal;         /* tick of that meal */
+    Regions *regions;               /* connected parts of the free cells, kept up to date on every move */
+} Planner;
+
+/* Function prototypes */
+Planner *startPlanner(const GameState *state);
+Input plannerInput(Planner *planner, const GameState *state);
+void freePlanner(Planner *planner);
+/* */
+
+#endif //PLANNER_H
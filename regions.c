@@ -0,0 +1,444 @@
+/* 
+ * regions.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "regions.h"
+/* */
+
+/* Movement of each direction, indexed by Direction */
+static const int moveX[] = { 0, 0, -1, 1 };
+static const int moveY[] = { -1, 1, 0, 0 };
+/* */
+
+/* Pieces structure, what a split search found around a taken cell */
+typedef struct Pieces {
+    unsigned int count;             /* searches, one per group of free neighbours */
+    int parent[REGION_PIECES];      /* searches that met are the same piece */
+    uint32_t cells[REGION_PIECES];  /* cells of each piece, by its first search */
+    int open;                       /* piece still growing when the others were done, -1 when none */
+    uint32_t mark;                  /* stamp of the search, its piece in the low two bits */
+} Pieces;
+
+/* Function prototypes for the internal helpers */
+static void buildRegions(Regions *regions, const GameState *state);
+static void freeCell(Regions *regions, unsigned int cell);
+static void takeCell(Regions *regions, unsigned int cell);
+static unsigned int neighbourGroups(const Regions *regions, unsigned int cell, unsigned int *starts);
+static void searchPieces(Regions *regions, unsigned int removed, const unsigned int *starts, unsigned int count,
+                         Pieces *pieces);
+static uint32_t relabel(Regions *regions, unsigned int start, uint32_t from, uint32_t to);
+static void pushQueue(Regions *regions, unsigned int piece, uint32_t cell);
+/* */
+
+/* Neighbour helpers. Free cells only lie on the sides that wrap, the others are walls,
+ * so the cells around a free cell are always on the board and only need wrapping on such boards */
+static inline unsigned int offsetCell(const Regions *regions, unsigned int cell, int dx, int dy) {
+    if (!regions->wrapX && !regions->wrapY) return cell + dy * regions->width + dx;
+
+    int x = (int)(cell % regions->width) + dx, y = (int)(cell / regions->width) + dy;
+    if (regions->wrapX) x = (x + regions->width) % regions->width;
+    if (regions->wrapY) y = (y + regions->height) % regions->height;
+    return (unsigned int)y * regions->width + x;
+}
+
+static inline void neighbourCells(const Regions *regions, unsigned int cell, unsigned int *next) {
+    next[0] = offsetCell(regions, cell, 0, -1);
+    next[1] = offsetCell(regions, cell, 1, 0);
+    next[2] = offsetCell(regions, cell, 0, 1);
+    next[3] = offsetCell(regions, cell, -1, 0);
+}
+
+static inline int pieceOf(const Pieces *pieces, int search) {
+    while (pieces->parent[search] != search) search = pieces->parent[search];
+    return search;
+}
+/* */
+
+/* Function responsible of allocating the regions of a game's board and labelling them */
+Regions *startRegions(const GameState *state) {
+    Regions *regions = calloc(1, sizeof(Regions));
+    size_t cells = (size_t)state->board.width * state->board.height;
+
+    regions->width = state->board.width;
+    regions->height = state->board.height;
+    regions->label = calloc(cells, sizeof(uint32_t));
+    regions->size = calloc(cells + 1, sizeof(uint32_t));
+    regions->spare = malloc(cells * sizeof(uint32_t));
+    regions->stamp = calloc(cells, sizeof(uint32_t));
+    for (int i = 0; i < REGION_PIECES; i++) {
+        regions->queueCapacity[i] = 64;
+        regions->queue[i] = malloc(regions->queueCapacity[i] * sizeof(uint32_t));
+    }
+
+    buildRegions(regions, state);
+    return regions;
+}
+
+/* Function responsible of bringing the regions up to date with the game. A single tick since the last sync
+ * is replayed like updateSnake made it, the tail freed and then the head taken, anything else is built again */
+void syncRegions(Regions *regions, const GameState *state) {
+    const Snake *snake = &state->snake;
+    if (regions->synced && state->ticks == regions->ticks && snake->head == regions->head &&
+        snake->length == regions->length) return;
+
+    unsigned int expected = (regions->head == 0 ? snake->capacity : regions->head) - 1;
+    if (!regions->synced || state->ticks != regions->ticks + 1 || snake->head != expected ||
+        snake->length < regions->length || snake->length > regions->length + 1) {
+        buildRegions(regions, state);
+        return;
+    }
+
+    /* The old tail is still in its ring slot, the new head only took the slot before the old head */
+    if (snake->length == regions->length) {
+        unsigned int slot = regions->head + regions->length - 1;
+        if (slot >= snake->capacity) slot -= snake->capacity;
+        freeCell(regions, boardCell(&state->board, snake->body[slot].pX, snake->body[slot].pY));
+    }
+    takeCell(regions, boardCell(&state->board, snake->body[snake->head].pX, snake->body[snake->head].pY));
+
+    regions->ticks = state->ticks;
+    regions->head = snake->head;
+    regions->length = snake->length;
+}
+
+/* Function returning whether the head can reach a free cell, going over free cells only */
+bool headReaches(const Regions *regions, const GameState *state, int x, int y) {
+    if (cellBlocked(state, x, y)) return false;
+
+    Position *head = snakeSegment(state, 0);
+    uint32_t target = regions->label[boardCell(&state->board, x, y)];
+    unsigned int next[4];
+    neighbourCells(regions, boardCell(&state->board, head->pX, head->pY), next);
+    for (int d = 0; d < 4; d++) {
+        if (regions->label[next[d]] == target) return true;
+    }
+    return false;
+}
+
+/* Function responsible of finding what the head has around it after a move, returns false when the move dies.
+ * Moves that do not split the region are answered from the labels, the others walk the smaller pieces only.
+ * The body is taken where it is now, only the tail the head moves into is counted as leaving */
+bool probeMove(Regions *regions, const GameState *state, Direction direction, MoveRoom *room) {
+    Position *head = snakeSegment(state, 0);
+    Position *tail = snakeSegment(state, snakeSize(state) - 1);
+    int x = head->pX + moveX[direction], y = head->pY + moveY[direction];
+    wrapCell(&state->board, &x, &y);
+    memset(room, 0, sizeof(MoveRoom));
+    if (wallCollision(state, x, y)) return false;
+
+    unsigned int cell = boardCell(&state->board, x, y);
+    unsigned int tailCell = boardCell(&state->board, tail->pX, tail->pY);
+    uint32_t apple = state->apple.pX < 0 ? REGION_NONE
+                   : regions->label[boardCell(&state->board, state->apple.pX, state->apple.pY)];
+    uint32_t label = regions->label[cell];
+    unsigned int next[4];
+    neighbourCells(regions, cell, next);
+
+    /* The tail is only safe to move into when it moves on, the head then follows it into the regions around */
+    if (label == REGION_NONE) {
+        if (cell != tailCell || state->snake.growth > 0 || snakeSize(state) < 2) return false;
+        for (int d = 0; d < 4; d++) {
+            uint32_t around = regions->label[next[d]];
+            if (around == REGION_NONE) continue;
+            if (regions->size[around] > room->room) room->room = regions->size[around];
+            if (around == apple) room->apple = true;
+        }
+        room->tailRoom = room->room;
+        return true;
+    }
+
+    /* Next to the tail, the head can always follow it */
+    bool nextToTail = false;
+    for (int d = 0; d < 4; d++) nextToTail = nextToTail || next[d] == tailCell;
+    unsigned int tailNext[4];
+    neighbourCells(regions, tailCell, tailNext);
+    room->apple = apple == label;
+
+    unsigned int starts[REGION_PIECES];
+    unsigned int groups = neighbourGroups(regions, cell, starts);
+    if (groups <= 1) {
+        room->room = regions->size[label] - 1;
+        for (int d = 0; d < 4; d++) nextToTail = nextToTail || (tailNext[d] != cell && regions->label[tailNext[d]] == label);
+        room->tailRoom = nextToTail ? room->room : 0;
+        return true;
+    }
+
+    /* The move may split the region, the pieces that end are walked and the one still growing gets the rest */
+    Pieces pieces;
+    searchPieces(regions, cell, starts, groups, &pieces);
+    uint32_t rest = regions->size[label] - 1;
+    for (unsigned int i = 0; i < pieces.count; i++) {
+        if (pieceOf(&pieces, i) == (int)i && (int)i != pieces.open) rest -= pieces.cells[i];
+    }
+    for (unsigned int i = 0; i < pieces.count; i++) {
+        if (pieceOf(&pieces, i) != (int)i) continue;
+        uint32_t cells = (int)i == pieces.open ? rest : pieces.cells[i];
+        if (cells > room->room) room->room = cells;
+        if (nextToTail && cells > room->tailRoom) room->tailRoom = cells;
+    }
+    for (int d = 0; d < 4 && !nextToTail; d++) {
+        if (tailNext[d] == cell || regions->label[tailNext[d]] != label) continue;
+        uint32_t stamp = regions->stamp[tailNext[d]];
+        int piece = (stamp & ~3u) == pieces.mark ? pieceOf(&pieces, stamp & 3) : pieces.open;
+        uint32_t cells = piece == pieces.open ? rest : pieces.cells[piece];
+        if (cells > room->tailRoom) room->tailRoom = cells;
+    }
+    return true;
+}
+
+/* Function returning whether the head is about to enter a region cut off from the tail and too small for the snake */
+bool trapAhead(Regions *regions, const GameState *state) {
+    MoveRoom room;
+    if (!state->isAlive || !probeMove(regions, state, state->snake.direction, &room)) return false;
+    return room.tailRoom == 0 && room.room < (unsigned int)snakeSize(state);
+}
+
+/* Function responsible of freeing the regions */
+void freeRegions(Regions *regions) {
+    free(regions->label);
+    free(regions->size);
+    free(regions->spare);
+    free(regions->stamp);
+    for (int i = 0; i < REGION_PIECES; i++) free(regions->queue[i]);
+    free(regions);
+}
+
+/* Function responsible of labelling every region from scratch, a flood fill over the whole board */
+static void buildRegions(Regions *regions, const GameState *state) {
+    size_t cells = (size_t)regions->width * regions->height;
+    regions->wrapX = state->board.wrapX;
+    regions->wrapY = state->board.wrapY;
+
+    /* Free cells start with a label no region has, then each unlabelled one starts a new region */
+    for (size_t i = 0; i < cells; i++) {
+        regions->label[i] = boardTest(state->board.occupied, i) ? REGION_NONE : UINT32_MAX;
+    }
+    regions->spareCount = 0;
+    for (size_t label = cells; label >= 1; label--) regions->spare[regions->spareCount++] = label;
+    for (size_t i = 0; i < cells; i++) {
+        if (regions->label[i] != UINT32_MAX) continue;
+        uint32_t label = regions->spare[--regions->spareCount];
+        regions->size[label] = relabel(regions, i, UINT32_MAX, label);
+    }
+
+    regions->synced = true;
+    regions->ticks = state->ticks;
+    regions->head = state->snake.head;
+    regions->length = state->snake.length;
+}
+
+/* Function responsible of giving a cell back to the free cells, joining every region around it into the biggest */
+static void freeCell(Regions *regions, unsigned int cell) {
+    if (regions->label[cell] != REGION_NONE) return;
+
+    unsigned int next[4];
+    neighbourCells(regions, cell, next);
+    uint32_t label = REGION_NONE;
+    for (int d = 0; d < 4; d++) {
+        uint32_t around = regions->label[next[d]];
+        if (around != REGION_NONE && (label == REGION_NONE || regions->size[around] > regions->size[label])) {
+            label = around;
+        }
+    }
+
+    /* The smaller regions are relabelled, so a cell changes label a logarithmic number of times between splits */
+    if (label == REGION_NONE) {
+        label = regions->spare[--regions->spareCount];
+        regions->size[label] = 0;
+    }
+    for (int d = 0; d < 4; d++) {
+        uint32_t around = regions->label[next[d]];
+        if (around == REGION_NONE || around == label) continue;
+        regions->size[label] += relabel(regions, next[d], around, label);
+        regions->spare[regions->spareCount++] = around;
+    }
+
+    regions->label[cell] = label;
+    regions->size[label]++;
+}
+
+/* Function responsible of taking a cell from the free cells. When its free neighbours are not joined around it
+ * they may now be apart, the pieces are walked together and all but the last one growing get labels of their own */
+static void takeCell(Regions *regions, unsigned int cell) {
+    uint32_t label = regions->label[cell];
+    if (label == REGION_NONE) return;
+
+    regions->label[cell] = REGION_NONE;
+    if (--regions->size[label] == 0) {
+        regions->spare[regions->spareCount++] = label;
+        return;
+    }
+
+    unsigned int starts[REGION_PIECES];
+    unsigned int groups = neighbourGroups(regions, cell, starts);
+    if (groups <= 1) return;
+
+    Pieces pieces;
+    searchPieces(regions, cell, starts, groups, &pieces);
+
+    /* When every piece ended, the biggest keeps the label */
+    int keep = pieces.open;
+    for (unsigned int i = 0; pieces.open < 0 && i < pieces.count; i++) {
+        if (pieceOf(&pieces, i) == (int)i && (keep < 0 || pieces.cells[i] > pieces.cells[keep])) keep = i;
+    }
+    for (unsigned int i = 0; i < pieces.count; i++) {
+        if (pieceOf(&pieces, i) != (int)i || (int)i == keep) continue;
+
+        uint32_t split = regions->spare[--regions->spareCount];
+        regions->size[split] = pieces.cells[i];
+        regions->size[label] -= pieces.cells[i];
+        for (unsigned int j = 0; j < pieces.count; j++) {
+            if (pieceOf(&pieces, j) != (int)i) continue;
+            for (uint32_t k = 0; k < regions->queueLength[j]; k++) regions->label[regions->queue[j][k]] = split;
+        }
+    }
+}
+
+/* Function responsible of grouping the free neighbours of a cell that are joined through the cells around it,
+ * returns the number of groups and one neighbour of each. Neighbours of one group stay connected without the cell */
+static unsigned int neighbourGroups(const Regions *regions, unsigned int cell, unsigned int *starts) {
+    unsigned int next[4];
+    neighbourCells(regions, cell, next);
+    unsigned int corner[4] = { offsetCell(regions, cell, 1, -1), offsetCell(regions, cell, 1, 1),
+                               offsetCell(regions, cell, -1, 1), offsetCell(regions, cell, -1, -1) };
+    bool free[4];
+    int group[4];
+
+    for (int d = 0; d < 4; d++) {
+        free[d] = regions->label[next[d]] != REGION_NONE;
+        group[d] = d;
+    }
+
+    /* Neighbours next to each other around the cell are joined by the corner between them */
+    for (int d = 0; d < 4; d++) {
+        int after = (d + 1) & 3;
+        if (!free[d] || !free[after] || regions->label[corner[d]] == REGION_NONE) continue;
+        int from = group[after], to = group[d];
+        for (int i = 0; i < 4; i++) {
+            if (group[i] == from) group[i] = to;
+        }
+    }
+
+    unsigned int count = 0;
+    for (int d = 0; d < 4; d++) {
+        if (free[d] && group[d] == d) starts[count++] = next[d];
+    }
+    return count;
+}
+
+/* Function responsible of walking the pieces around a taken cell breadth-first, one cell of each in turn.
+ * Searches that meet are the same piece, and it stops once at most one piece is still growing,
+ * so the cost is the size of the smaller pieces and not of the whole region */
+static void searchPieces(Regions *regions, unsigned int removed, const unsigned int *starts, unsigned int count,
+                         Pieces *pieces) {
+    uint32_t label = regions->label[starts[0]];
+    uint32_t head[REGION_PIECES];
+
+    /* Stamps tell the searches apart without clearing anything, until the generations run out */
+    if (++regions->generation >= (1u << 30)) {
+        memset(regions->stamp, 0, (size_t)regions->width * regions->height * sizeof(uint32_t));
+        regions->generation = 1;
+    }
+    pieces->mark = regions->generation << 2;
+    pieces->count = count;
+    pieces->open = -1;
+    for (unsigned int i = 0; i < count; i++) {
+        pieces->parent[i] = i;
+        pieces->cells[i] = 0;
+        head[i] = 0;
+        regions->queueLength[i] = 0;
+        regions->stamp[starts[i]] = pieces->mark | i;
+        pushQueue(regions, i, starts[i]);
+    }
+
+    for (;;) {
+        /* Count the pieces with cells left to expand */
+        bool counted[REGION_PIECES] = { false };
+        unsigned int growing = 0;
+        int last = -1;
+        for (unsigned int i = 0; i < count; i++) {
+            int piece = pieceOf(pieces, i);
+            if (head[i] == regions->queueLength[i] || counted[piece]) continue;
+            counted[piece] = true;
+            growing++;
+            last = piece;
+        }
+        if (growing <= 1) {
+            pieces->open = last;
+            break;
+        }
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (head[i] == regions->queueLength[i]) continue;
+
+            unsigned int next[4];
+            neighbourCells(regions, regions->queue[i][head[i]++], next);
+            for (int d = 0; d < 4; d++) {
+                if (next[d] == removed || regions->label[next[d]] != label) continue;
+
+                uint32_t stamp = regions->stamp[next[d]];
+                if ((stamp & ~3u) == pieces->mark) {
+                    int a = pieceOf(pieces, i), b = pieceOf(pieces, stamp & 3);
+                    if (a != b) pieces->parent[a] = b;
+                    continue;
+                }
+                regions->stamp[next[d]] = pieces->mark | i;
+                pushQueue(regions, i, next[d]);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < count; i++) pieces->cells[pieceOf(pieces, i)] += regions->queueLength[i];
+}
+
+/* Function responsible of moving the cells of a region from one label to another, returns how many there were */
+static uint32_t relabel(Regions *regions, unsigned int start, uint32_t from, uint32_t to) {
+    regions->queueLength[0] = 0;
+    regions->label[start] = to;
+    pushQueue(regions, 0, start);
+
+    for (uint32_t i = 0; i < regions->queueLength[0]; i++) {
+        unsigned int next[4];
+        neighbourCells(regions, regions->queue[0][i], next);
+        for (int d = 0; d < 4; d++) {
+            if (regions->label[next[d]] != from) continue;
+            regions->label[next[d]] = to;
+            pushQueue(regions, 0, next[d]);
+        }
+    }
+
+    return regions->queueLength[0];
+}
+
+/* Function responsible of adding a cell to the queue of a piece, growing it when needed */
+static void pushQueue(Regions *regions, unsigned int piece, uint32_t cell) {
+    if (regions->queueLength[piece] == regions->queueCapacity[piece]) {
+        regions->queueCapacity[piece] *= 2;
+        regions->queue[piece] = realloc(regions->queue[piece], regions->queueCapacity[piece] * sizeof(uint32_t));
+    }
+    regions->queue[piece][regions->queueLength[piece]++] = cell;
+}
@@ -0,0 +1,47 @@
+#ifndef REGIONS_H
+#define REGIONS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+
+/* Region constants */
+#define REGION_NONE      0          /* label of the cells that are not free */
+#define REGION_PIECES    4          /* most pieces a region can break into when one cell is taken */
+/* */
+
+/* Regions structure, the connected parts of the free cells of a board, kept up to date one tick at a time.
+ * Every free cell holds the label of its region, so two cells are connected when their labels are equal */
+typedef struct Regions {
+    int width, height;
+    bool wrapX, wrapY;              /* sides of the board that wrap, taken from the game on every build */
+    uint32_t *label;                /* region of every cell, REGION_NONE for walls and the body */
+    uint32_t *size;                 /* free cells of every region, by label */
+    uint32_t *spare;                /* labels not in use */
+    uint32_t spareCount;
+    uint32_t *stamp;                /* generation and piece of the split search that last reached a cell */
+    uint32_t generation;
+    uint32_t *queue[REGION_PIECES]; /* cells reached by each piece of a split search */
+    uint32_t queueLength[REGION_PIECES];
+    uint32_t queueCapacity[REGION_PIECES];
+    bool synced;                    /* the labels match the game below */
+    unsigned long ticks;            /* tick of the game the labels match */
+    unsigned int head, length;      /* ring slot of the head and length of the snake on that tick */
+} Regions;
+
+/* Move room structure, what the head finds after a move */
+typedef struct MoveRoom {
+    unsigned int room;              /* free cells of the largest region the head can go on into */
+    unsigned int tailRoom;          /* free cells of the region it can go on into that touches the tail, 0 when none */
+    bool apple;                     /* the apple is in one of them */
+} MoveRoom;
+
+/* Function prototypes */
+Regions *startRegions(const GameState *state);
+void syncRegions(Regions *regions, const GameState *state);
+bool headReaches(const Regions *regions, const GameState *state, int x, int y);
+bool probeMove(Regions *regions, const GameState *state, Direction direction, MoveRoom *room);
+bool trapAhead(Regions *regions, const GameState *state);
+void freeRegions(Regions *regions);
+/* */
+
+#endif //REGIONS_H
@@ -0,0 +1,377 @@
+/* 
+ * render.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <string.h>
+#include <ncurses.h>
+#include "game.h"
+#include "render.h"
+/* */
+
+/* Global variables */
+const Renderer *renderer = &cursesRenderer;    /* backend drawing the game */
+Layout layout;                        /* where the board and the menu are on the screen */
+WINDOW *gameBoard;                    /* curses window holding the visible part of the game board */
+WINDOW *menuScreen;                   /* curses window holding the menu */
+bool menuShown = false;               /* the menu window is on the screen, not the board */
+int shownScore = -1;                  /* score currently drawn on the board */
+bool trapWanted = false;              /* the trap warning should be on the board */
+int shownTrap = -1;                   /* whether the trap warning is drawn, -1 when unknown */
+int viewX, viewY;                     /* board cell shown at the top left corner of the window */
+/* */
+
+/* Function prototypes for the internal helpers */
+static bool followHead(const GameState *state, bool center);
+static Glyph headGlyph(Direction direction);
+static Glyph wallGlyph(int x, int y, int right, int bottom);
+static bool cursesStart(int width, int height);
+static void cursesStop();
+static void cursesClearScreen();
+static void cursesPutCell(int row, int col, Glyph glyph);
+static void cursesPutText(int row, int col, const char *text);
+static void cursesFinishFrame();
+static void cursesPresent();
+static void cursesOpenMenu();
+static void cursesMenuText(int row, int col, const char *text);
+static int cursesReadKey(bool wait);
+static void cursesAlert();
+/* */
+
+/* ncurses backend, the default one */
+const Renderer cursesRenderer = {
+    "curses", cursesStart, cursesStop, cursesClearScreen, cursesPutCell, cursesPutText, cursesFinishFrame,
+    cursesPresent, cursesOpenMenu, cursesMenuText, cursesReadKey, cursesAlert
+};
+/* */
+
+/* Function returning the backend with the given name, NULL when there is none */
+const Renderer *findRenderer(const char *name) {
+    if (strcmp(name, cursesRenderer.name) == 0) return &cursesRenderer;
+    if (strcmp(name, ansiRenderer.name) == 0) return &ansiRenderer;
+    return NULL;
+}
+
+/* Function responsible of placing the menu and the board view on a terminal, false when the menu does not fit.
+ * The menu is centered, boards bigger than the terminal are shown through a view as big as the terminal */
+bool layoutScreen(int terminalRows, int terminalCols, int width, int height) {
+    if (SCREEN_HEIGHT > terminalRows || SCREEN_WIDTH > terminalCols) return false;
+
+    layout.terminalRows = terminalRows;
+    layout.terminalCols = terminalCols;
+    layout.menuTop = (terminalRows - SCREEN_HEIGHT) / 2;
+    layout.menuLeft = (terminalCols - SCREEN_WIDTH) / 2;
+    layout.viewRows = height < terminalRows ? height : terminalRows;
+    layout.viewCols = width < terminalCols ? width : terminalCols;
+    layout.viewTop = (terminalRows - layout.viewRows) / 2;
+    layout.viewLeft = (terminalCols - layout.viewCols) / 2;
+    return true;
+}
+
+/* Function responsible of drawing the whole visible board, used when a game starts or the view scrolls */
+void drawBoard(GameState *state) {
+    /* Put the head back in the middle of the view */
+    followHead(state, true);
+
+    /* Draw every visible cell, walls included, so the cost depends on the window and not on the snake */
+    for (int y = viewY; y < viewY + layout.viewRows; y++) {
+        for (int x = viewX; x < viewX + layout.viewCols; x++) {
+            drawCell(state, x, y);
+        }
+    }
+
+    /* Force the score and the trap warning to be drawn again */
+    shownScore = -1;
+    shownTrap = -1;
+    clearDirty(state);
+}
+
+/* Function responsible of drawing whatever is on a single cell of the board, cells out of view are skipped */
+void drawCell(const GameState *state, int x, int y) {
+    if (x < viewX || y < viewY || x >= viewX + layout.viewCols || y >= viewY + layout.viewRows) return;
+
+    Glyph glyph = GLYPH_EMPTY;
+    const FoodItem *item;
+    Position *head = snakeSegment(state, 0);
+    int right = state->board.width - 1, bottom = state->board.height - 1;
+
+    if (head->pX == x && head->pY == y) {
+        /* Draw the snake's head facing its direction */
+        glyph = headGlyph(state->snake.direction);
+    } else if (snakeCollision(state, x, y, true)) {
+        glyph = GLYPH_BODY;
+    } else if (appleCollision(state, x, y)) {
+        glyph = GLYPH_FOOD;
+    } else if (cellBlocked(state, x, y)) {
+        /* Whatever blocks the snake and is not the snake is a wall */
+        glyph = wallGlyph(x, y, right, bottom);
+    } else if ((item = findFood(state, x, y)) != NULL) {
+        glyph = item->kind == FOOD_BONUS ? GLYPH_FOOD_BONUS : item->kind == FOOD_TIMED ? GLYPH_FOOD_TIMED : GLYPH_FOOD;
+    }
+
+    renderer->putCell(y - viewY, x - viewX, glyph);
+}
+
+/* Function returning the glyph of a head facing the given direction */
+static Glyph headGlyph(Direction direction) {
+    switch (direction) {
+        case LEFT:  return GLYPH_HEAD_LEFT;
+        case RIGHT: return GLYPH_HEAD_RIGHT;
+        case UP:    return GLYPH_HEAD_UP;
+        default:    return GLYPH_HEAD_DOWN;
+    }
+}
+
+/* Function returning the glyph of a wall cell, walls on the sides are drawn like a box around the board */
+static Glyph wallGlyph(int x, int y, int right, int bottom) {
+    if (y == 0) return x == 0 ? GLYPH_CORNER_UL : x == right ? GLYPH_CORNER_UR : GLYPH_WALL_H;
+    if (y == bottom) return x == 0 ? GLYPH_CORNER_LL : x == right ? GLYPH_CORNER_LR : GLYPH_WALL_H;
+    return x == 0 || x == right ? GLYPH_WALL_V : GLYPH_BLOCK;
+}
+
+/* Function responsible of scrolling the view when the head gets close to its edges, returns whether it moved */
+static bool followHead(const GameState *state, bool center) {
+    int rows = layout.viewRows, cols = layout.viewCols;
+    Position *head = snakeSegment(state, 0);
+    int oldX = viewX, oldY = viewY;
+
+    /* Recenter on the head once it enters the outer quarter of the view on either axis */
+    if (center || head->pX < viewX + cols / 4 || head->pX >= viewX + cols - cols / 4) viewX = head->pX - cols / 2;
+    if (center || head->pY < viewY + rows / 4 || head->pY >= viewY + rows - rows / 4) viewY = head->pY - rows / 2;
+
+    /* Never show anything past the borders, a board that fits the window is never scrolled */
+    if (viewX > state->board.width - cols) viewX = state->board.width - cols;
+    if (viewY > state->board.height - rows) viewY = state->board.height - rows;
+    if (viewX < 0) viewX = 0;
+    if (viewY < 0) viewY = 0;
+
+    return viewX != oldX || viewY != oldY;
+}
+
+/* Function responsible of drawing each object in the screen */
+void drawGame(GameState *state) {
+    if (state->dirtyOverflow || followHead(state, false)) {
+        /* Too many cells changed since the last frame, or the view scrolled, draw everything again */
+        drawBoard(state);
+    } else {
+        /* Only draw the cells that changed: old head, new head, vacated tail and moved apple */
+        for (unsigned int i = 0; i < state->dirtyCount; i++) {
+            drawCell(state, state->dirtyCells[i].pX, state->dirtyCells[i].pY);
+            if (state->dirtyCells[i].pY == viewY) shownScore = shownTrap = -1;
+        }
+        clearDirty(state);
+    }
+
+    /* The head is always drawn again in case it turned while paused */
+    Position *head = snakeSegment(state, 0);
+    drawCell(state, head->pX, head->pY);
+
+    /* The score and the trap warning sit on the top row of the view, which is playfield once the view scrolls
+     * or the board wraps vertically, so whatever was drawn there may have gone over them */
+    if (head->pY == viewY) shownScore = shownTrap = -1;
+
+    /* Display the game score when it changes */
+    int currentScore = gameScore(state);
+    if (currentScore != shownScore) {
+        char text[32];
+        snprintf(text, sizeof(text), "Score: %d", currentScore);
+        renderer->putText(0, 1, text);
+        shownScore = currentScore;
+    }
+
+    /* Display the trap warning at the right of the top row when it changes, the board shows again when it goes */
+    if ((int)trapWanted != shownTrap) {
+        int col = layout.viewCols - (int)strlen(TRAP_WARNING) - 1;
+        if (trapWanted) {
+            renderer->putText(0, col, TRAP_WARNING);
+        } else {
+            for (int i = 0; i < (int)strlen(TRAP_WARNING); i++) drawCell(state, viewX + col + i, viewY);
+        }
+        shownTrap = trapWanted;
+    }
+
+    /* Queue the changes, the caller sends them to the terminal all at once with present */
+    renderer->finishFrame();
+}
+
+/* Function responsible of asking for the trap warning, it is drawn with the next frame */
+void warnTrap(bool trapped) {
+    trapWanted = trapped;
+}
+
+/* Function responsible of drawing the part of an arena around a snake.
+ * Most cells change on every tick with this many snakes, so the whole view is drawn and the backend keeps what did not change */
+void drawArena(const Arena *arena, uint32_t follow) {
+    int rows = layout.viewRows, cols = layout.viewCols;
+    int right = arena->width - 1, bottom = arena->height - 1;
+    const Position *center = arenaHead(arena, follow);
+
+    /* Keep the followed head in the middle of the view, never showing anything past the borders */
+    viewX = center->pX - cols / 2;
+    viewY = center->pY - rows / 2;
+    if (viewX > arena->width - cols) viewX = arena->width - cols;
+    if (viewY > arena->height - rows) viewY = arena->height - rows;
+    if (viewX < 0) viewX = 0;
+    if (viewY < 0) viewY = 0;
+
+    for (int y = viewY; y < viewY + rows; y++) {
+        for (int x = viewX; x < viewX + cols; x++) {
+            SnakeId owner = arena->owner[(size_t)y * arena->width + x];
+            Glyph glyph;
+
+            if (owner == ARENA_EMPTY) {
+                glyph = GLYPH_EMPTY;
+            } else if (owner == ARENA_APPLE) {
+                glyph = GLYPH_FOOD;
+            } else if (owner == ARENA_WALL) {
+                glyph = wallGlyph(x, y, right, bottom);
+            } else {
+                /* The grid only knows the owner, its head is found through the snake */
+                const ArenaSnake *snake = &arena->snakes[owner - 1];
+                const Position *head = arenaHead(arena, owner - 1);
+                if (head->pX == x && head->pY == y) glyph = headGlyph(snake->direction);
+                else glyph = owner - 1u == follow ? GLYPH_BODY : GLYPH_RIVAL;
+            }
+
+            renderer->putCell(y - viewY, x - viewX, glyph);
+        }
+    }
+
+    /* The score and the snakes still in the game */
+    uint32_t alive = 0;
+    for (uint32_t i = 0; i < arena->count; i++) alive += arena->snakes[i].alive;
+    char text[64];
+    snprintf(text, sizeof(text), "Score: %d  Snakes: %u ", arenaScore(arena, follow), alive);
+    renderer->putText(0, 1, text);
+    shownScore = -1;
+
+    renderer->finishFrame();
+}
+
+/* Function responsible of setting up ncurses with a window for the board and one for the menu */
+static bool cursesStart(int width, int height) {
+    /* An offscreen terminal opened by the caller with newterm is used as is */
+    if (stdscr == NULL) initscr();
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    curs_set(0);
+
+    /* Detect if the terminal window is smaller than the menu, bigger boards are scrolled */
+    if (!layoutScreen(LINES, COLS, width, height)) {
+        endwin();
+        return false;
+    }
+
+    /* Create the game board window once, it is reused by every frame and shows as much of the board as fits */
+    gameBoard = newwin(layout.viewRows, layout.viewCols, layout.viewTop, layout.viewLeft);
+    keypad(gameBoard, TRUE);
+    nodelay(gameBoard, TRUE);
+
+    /* Keep the terminal in keypad mode in the menu too, arrow keys are only read once stdin is ready
+     * so the first one of a game would otherwise arrive before ncurses switched the mode back on */
+    menuScreen = newwin(SCREEN_HEIGHT, SCREEN_WIDTH, layout.menuTop, layout.menuLeft);
+    keypad(menuScreen, TRUE);
+    refresh();
+    return true;
+}
+
+/* Function responsible of ending ncurses */
+static void cursesStop() {
+    delwin(gameBoard);
+    delwin(menuScreen);
+    endwin();
+}
+
+/* Function responsible of clearing the screen around the board */
+static void cursesClearScreen() {
+    erase();
+    wnoutrefresh(stdscr);
+    menuShown = false;
+}
+
+/* Function responsible of putting a glyph on the board window, the box drawing ones come from the terminal */
+static void cursesPutCell(int row, int col, Glyph glyph) {
+    chtype ch = ' ';
+
+    switch (glyph) {
+        case GLYPH_EMPTY:      ch = ' '; break;
+        case GLYPH_BODY:       ch = SNAKE_BODY; break;
+        case GLYPH_RIVAL:      ch = RIVAL_BODY; break;
+        case GLYPH_HEAD_UP:    ch = SNAKE_HEAD_U; break;
+        case GLYPH_HEAD_DOWN:  ch = SNAKE_HEAD_D; break;
+        case GLYPH_HEAD_LEFT:  ch = SNAKE_HEAD_L; break;
+        case GLYPH_HEAD_RIGHT: ch = SNAKE_HEAD_R; break;
+        case GLYPH_FOOD:       ch = FOOD; break;
+        case GLYPH_FOOD_TIMED: ch = FOOD_TIMED_ITEM; break;
+        case GLYPH_FOOD_BONUS: ch = FOOD_BONUS_ITEM; break;
+        case GLYPH_WALL_H:     ch = ACS_HLINE; break;
+        case GLYPH_WALL_V:     ch = ACS_VLINE; break;
+        case GLYPH_CORNER_UL:  ch = ACS_ULCORNER; break;
+        case GLYPH_CORNER_UR:  ch = ACS_URCORNER; break;
+        case GLYPH_CORNER_LL:  ch = ACS_LLCORNER; break;
+        case GLYPH_CORNER_LR:  ch = ACS_LRCORNER; break;
+        case GLYPH_BLOCK:      ch = ACS_CKBOARD; break;
+    }
+
+    mvwaddch(gameBoard, row, col, ch);
+}
+
+/* Function responsible of writing text on the board window */
+static void cursesPutText(int row, int col, const char *text) {
+    mvwaddstr(gameBoard, row, col, text);
+}
+
+/* Function responsible of queueing the board window, ncurses works out what changed */
+static void cursesFinishFrame() {
+    wnoutrefresh(gameBoard);
+}
+
+/* Function responsible of sending everything queued to the terminal in a single doupdate */
+static void cursesPresent() {
+    if (menuShown) wnoutrefresh(menuScreen);
+    doupdate();
+}
+
+/* Function responsible of blanking the screen and drawing the menu box */
+static void cursesOpenMenu() {
+    /* The board window may be bigger than the menu, clear whatever it left around it */
+    erase();
+    wnoutrefresh(stdscr);
+    wclear(menuScreen);
+    box(menuScreen, 0, 0);
+    menuShown = true;
+}
+
+/* Function responsible of writing text on the menu window */
+static void cursesMenuText(int row, int col, const char *text) {
+    mvwaddstr(menuScreen, row, col, text);
+}
+
+/* Function responsible of reading a key, the menu waits for one while the game only takes what is there */
+static int cursesReadKey(bool wait) {
+    return wgetch(wait ? menuScreen : gameBoard);
+}
+
+/* Function responsible of ringing the terminal bell */
+static void cursesAlert() {
+    beep();
+}
@@ -0,0 +1,84 @@
+#ifndef RENDER_H
+#define RENDER_H
+#include <stdbool.h>
+#include <ncurses.h>
+#include "game.h"
+#include "arena.h"
+
+/* Glyphs */
+#define SNAKE_BODY       '*'        /* snake's body */
+#define RIVAL_BODY       'o'        /* body of the other snakes of an arena */
+#define SNAKE_HEAD_U     'v'        /* head when going up */
+#define SNAKE_HEAD_D     '^'        /* head when going down */
+#define SNAKE_HEAD_L     '>'        /* head when going left */
+#define SNAKE_HEAD_R     '<'        /* head when going right  */
+#define FOOD             '@'        /* normal food */
+#define FOOD_TIMED_ITEM  '%'        /* food that disappears after a while */
+#define FOOD_BONUS_ITEM  '$'        /* food that disappears soon and grows the snake more */
+#define TRAP_WARNING     " TRAP "   /* shown while the snake heads into a region too small for it */
+/* */
+
+/* What a cell of the board shows, each backend decides how to put it on the terminal */
+typedef enum {
+    GLYPH_EMPTY,
+    GLYPH_BODY,
+    GLYPH_RIVAL,
+    GLYPH_HEAD_UP,
+    GLYPH_HEAD_DOWN,
+    GLYPH_HEAD_LEFT,
+    GLYPH_HEAD_RIGHT,
+    GLYPH_FOOD,
+    GLYPH_FOOD_TIMED,
+    GLYPH_FOOD_BONUS,
+    GLYPH_WALL_H,                   /* horizontal part of the box around the board */
+    GLYPH_WALL_V,
+    GLYPH_CORNER_UL,
+    GLYPH_CORNER_UR,
+    GLYPH_CORNER_LL,
+    GLYPH_CORNER_LR,
+    GLYPH_BLOCK                     /* wall inside the board, from a level */
+} Glyph;
+
+/* Renderer interface, the terminal backend behind drawGame() and mainMenu().
+ * Board coordinates are relative to the view, menu ones to the menu box, text may hold tabs */
+typedef struct Renderer {
+    const char *name;
+    bool (*start)(int width, int height);          /* take over the terminal, false when it is too small */
+    void (*stop)();                                /* give the terminal back */
+    void (*clearScreen)();                         /* blank the whole screen before a new board */
+    void (*putCell)(int row, int col, Glyph glyph);
+    void (*putText)(int row, int col, const char *text);
+    void (*finishFrame)();                         /* the board is complete, queue it for present */
+    void (*present)();                             /* send everything queued to the terminal */
+    void (*openMenu)();                            /* blank the screen and draw the empty menu box */
+    void (*menuText)(int row, int col, const char *text);
+    int (*readKey)(bool wait);                     /* next key as ncurses names it, ERR when none is waiting */
+    void (*alert)();                               /* ring the bell */
+} Renderer;
+
+/* Geometry of the screen shared by every backend, set by layoutScreen */
+typedef struct Layout {
+    int terminalRows, terminalCols;
+    int viewRows, viewCols;                        /* visible part of the board */
+    int viewTop, viewLeft;                         /* where the view is on the screen */
+    int menuTop, menuLeft;                         /* where the menu box is on the screen */
+} Layout;
+
+/* Backend in use and the ones to choose from */
+extern const Renderer *renderer;
+extern const Renderer cursesRenderer;
+extern const Renderer ansiRenderer;
+extern Layout layout;
+extern int ansiOutput;                             /* descriptor the ANSI backend writes its frames to */
+
+/* Function prototypes */
+const Renderer *findRenderer(const char *name);
+bool layoutScreen(int terminalRows, int terminalCols, int width, int height);
+void drawBoard(GameState *state);
+void drawCell(const GameState *state, int x, int y);
+void drawGame(GameState *state);
+void warnTrap(bool trapped);
+void drawArena(const Arena *arena, uint32_t follow);
+/* */
+
+#endif //RENDER_H
@@ -0,0 +1,229 @@
+/* 
+ * replay.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include "game.h"
+#include "replay.h"
+/* */
+
+/* Function prototypes for the internal helpers */
+static void writeVarint(FILE *file, uint64_t value);
+static bool readVarint(Replay *replay, uint64_t *value);
+static bool decodeEvent(Replay *replay);
+static bool checkEvents(Replay *replay);
+/* */
+
+/* Function responsible of creating a recording and writing its header */
+Recorder *startRecording(const char *path, uint64_t seed, int width, int height) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return NULL;
+
+    uint8_t header[REPLAY_HEADER];
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    for (int i = 0; i < 8; i++) header[5 + i] = seed >> (8 * i);
+    header[13] = width & 0xff;
+    header[14] = width >> 8;
+    header[15] = height & 0xff;
+    header[16] = height >> 8;
+    fwrite(header, 1, sizeof(header), file);
+
+    Recorder *recorder = malloc(sizeof(Recorder));
+    recorder->file = file;
+    recorder->lastTick = 0;
+    return recorder;
+}
+
+/* Function responsible of recording an input that changed the game */
+void recordInput(Recorder *recorder, const GameState *state, Input input) {
+    writeVarint(recorder->file, ((uint64_t)(state->ticks - recorder->lastTick) << 3) | input);
+    recorder->lastTick = state->ticks;
+}
+
+/* Function responsible of recording the end of a game, the file is flushed so finished games are never lost */
+void recordGameOver(Recorder *recorder) {
+    writeVarint(recorder->file, INPUT_NONE);
+    recorder->lastTick = 0;
+    fflush(recorder->file);
+}
+
+/* Function responsible of closing a recording */
+void stopRecording(Recorder *recorder) {
+    fclose(recorder->file);
+    free(recorder);
+}
+
+/* Function responsible of loading a recording, returns NULL if it can not be read */
+Replay *openReplay(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    Replay *replay = calloc(1, sizeof(Replay));
+    replay->data = malloc(size > 0 ? size : 1);
+    replay->size = fread(replay->data, 1, size, file);
+    fclose(file);
+
+    /* Check the header before trusting anything in it */
+    const uint8_t *header = replay->data;
+    if (replay->size < REPLAY_HEADER || memcmp(header, REPLAY_MAGIC, 4) != 0 || header[4] != REPLAY_VERSION) {
+        closeReplay(replay);
+        return NULL;
+    }
+
+    for (int i = 0; i < 8; i++) replay->seed |= (uint64_t)header[5 + i] << (8 * i);
+    replay->width = header[13] | header[14] << 8;
+    replay->height = header[15] | header[16] << 8;
+    replay->pos = REPLAY_HEADER;
+
+    /* Refuse boards the engine can not play, and events the replay could not follow */
+    if (replay->width < MIN_BOARD_SIZE || replay->width > MAX_BOARD_SIZE ||
+        replay->height < MIN_BOARD_SIZE || replay->height > MAX_BOARD_SIZE || !checkEvents(replay)) {
+        closeReplay(replay);
+        return NULL;
+    }
+    return replay;
+}
+
+/* Function responsible of returning the next recorded input if it is due at the current tick */
+bool replayInput(Replay *replay, const GameState *state, Input *input) {
+    if (!decodeEvent(replay) || replay->nextInput == INPUT_NONE || replay->nextTick != state->ticks) return false;
+
+    *input = replay->nextInput;
+    replay->lastTick = replay->nextTick;
+    replay->pending = false;
+    return true;
+}
+
+/* Function responsible of moving past the end of the current game, returns whether another game follows */
+bool replayNextGame(Replay *replay) {
+    if (decodeEvent(replay) && replay->nextInput == INPUT_NONE) replay->pending = false;
+    replay->lastTick = 0;
+    return replay->pos < replay->size;
+}
+
+/* Function responsible of checking whether the current game has no inputs left */
+bool replayFinished(Replay *replay) {
+    return !decodeEvent(replay) || replay->nextInput == INPUT_NONE;
+}
+
+/* Function responsible of freeing a replay */
+void closeReplay(Replay *replay) {
+    free(replay->data);
+    free(replay);
+}
+
+/* Function responsible of replaying every recorded game as fast as the CPU allows */
+void runReplayHeadless(Replay *replay, FILE *out) {
+    struct timespec start, end;
+    unsigned long long ticks = 0;
+    unsigned long games = 0;
+    Input input;
+
+    GameState *state = startGame(replay->width, replay->height, replay->seed);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        while (state->isAlive) {
+            while (replayInput(replay, state, &input)) applyInput(state, input);
+
+            /* Paused with nothing left to unpause it, the recording stopped here */
+            if (state->isPaused && replayFinished(replay)) break;
+
+            stepGame(state, INPUT_NONE);
+        }
+
+        games++;
+        ticks += state->ticks;
+        fprintf(out, "Game %lu: score %d after %lu ticks%s\n", games, gameScore(state), state->ticks,
+                state->isWon ? " (won)" : state->isAlive ? " (unfinished)" : "");
+
+        if (state->isAlive || !replayNextGame(replay)) break;
+        resetGame(state);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(out, "Replayed %llu ticks in %.6f s: %.0f ticks/sec\n", ticks, elapsed, elapsed > 0 ? ticks / elapsed : 0.0);
+
+    freeGame(state);
+}
+
+/* Function responsible of writing an unsigned LEB128 varint */
+static void writeVarint(FILE *file, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+/* Function responsible of reading an unsigned LEB128 varint */
+static bool readVarint(Replay *replay, uint64_t *value) {
+    *value = 0;
+
+    for (int shift = 0; replay->pos < replay->size && shift < 64; shift += 7) {
+        uint8_t byte = replay->data[replay->pos++];
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+/* Function responsible of decoding the next event unless one is already waiting */
+static bool decodeEvent(Replay *replay) {
+    uint64_t value;
+
+    if (replay->pending) return true;
+    if (!readVarint(replay, &value)) return false;
+
+    replay->nextTick = replay->lastTick + (value >> 3);
+    replay->nextInput = value & 7;
+    replay->pending = true;
+    return true;
+}
+
+/* Function responsible of checking every event of a recording before it is played, so a corrupt one is refused
+ * instead of stalling: inputs have to be Input values and ticks must not wrap. A varint cut short by a crash ends
+ * the recording, as it does while playing */
+static bool checkEvents(Replay *replay) {
+    unsigned long tick = 0;
+    uint64_t value;
+
+    while (readVarint(replay, &value)) {
+        uint64_t delta = value >> 3;
+        uint64_t input = value & 7;
+        if (input > INPUT_PAUSE || delta > ULONG_MAX - tick) return false;
+        tick = input == INPUT_NONE ? 0 : tick + delta;
+    }
+
+    replay->pos = REPLAY_HEADER;
+    return true;
+}
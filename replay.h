@@ -0,0 +1,48 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "game.h"
+
+/* Replay file constants */
+#define REPLAY_MAGIC     "SRPL"     /* first bytes of every recording */
+#define REPLAY_VERSION   2          /* format version, bumped whenever the engine plays a seed differently */
+#define REPLAY_HEADER    17         /* magic, version, seed, width and height */
+/* */
+
+/* Recording structure, inputs are written as they happen.
+ * Each event is a varint holding (ticks since the previous event << 3) | input,
+ * INPUT_NONE marks the end of a game, another game may follow. */
+typedef struct Recorder {
+    FILE *file;
+    unsigned long lastTick;         /* tick of the previous event in the current game */
+} Recorder;
+
+/* Replay structure, the whole recording is kept in memory */
+typedef struct Replay {
+    uint8_t *data;
+    size_t size;                    /* bytes in data */
+    size_t pos;                     /* next byte to decode */
+    uint64_t seed;
+    int width, height;
+    unsigned long lastTick;         /* tick of the previous event in the current game */
+    bool pending;                   /* an event was decoded but not applied yet */
+    unsigned long nextTick;         /* tick at which the pending event happens */
+    Input nextInput;                /* pending event, INPUT_NONE for the end of a game */
+} Replay;
+
+/* Function prototypes */
+Recorder *startRecording(const char *path, uint64_t seed, int width, int height);
+void recordInput(Recorder *recorder, const GameState *state, Input input);
+void recordGameOver(Recorder *recorder);
+void stopRecording(Recorder *recorder);
+Replay *openReplay(const char *path);
+bool replayInput(Replay *replay, const GameState *state, Input *input);
+bool replayNextGame(Replay *replay);
+bool replayFinished(Replay *replay);
+void closeReplay(Replay *replay);
+void runReplayHeadless(Replay *replay, FILE *out);
+/* */
+
+#endif //REPLAY_H
@@ -0,0 +1,66 @@
+/* 
+ * rng.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdint.h>
+#include "rng.h"
+/* */
+
+/* SplitMix64 step, used to spread a seed over the whole generator state */
+static uint64_t splitMix(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Function responsible of seeding a generator, each (seed, stream) pair gives an independent sequence */
+void seedRng(Rng *rng, uint64_t seed, uint64_t stream) {
+    /* Mix the stream number on its own first so that nearby streams of nearby seeds do not line up */
+    uint64_t mixer = stream;
+    uint64_t x = seed ^ splitMix(&mixer);
+
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitMix(&x);
+    }
+}
+
+/* Function responsible of splitting a generator: the child takes the current sequence
+ * and the parent jumps 2^128 draws ahead, so the two never overlap */
+void splitRng(Rng *parent, Rng *child) {
+    static const uint64_t jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s[4] = { 0, 0, 0, 0 };
+
+    *child = *parent;
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & ((uint64_t)1 << b)) {
+                for (int k = 0; k < 4; k++) s[k] ^= parent->s[k];
+            }
+            nextRng(parent);
+        }
+    }
+
+    for (int k = 0; k < 4; k++) parent->s[k] = s[k];
+}
@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+/* Random number generator state (xoshiro256**), small enough to live inside every game */
+typedef struct Rng {
+    uint64_t s[4];
+} Rng;
+
+/* Function prototypes */
+void seedRng(Rng *rng, uint64_t seed, uint64_t stream);
+void splitRng(Rng *parent, Rng *child);
+/* */
+
+/* Rotate helper */
+static inline uint64_t rotateLeft(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Function returning the next 64 random bits */
+static inline uint64_t nextRng(Rng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotateLeft(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 45);
+
+    return result;
+}
+
+/* Function returning a number in [0, bound) without modulo bias (Lemire's multiply and reject) */
+static inline uint32_t boundedRng(Rng *rng, uint32_t bound) {
+    uint64_t m = (uint64_t)(uint32_t)(nextRng(rng) >> 32) * bound;
+    uint32_t low = (uint32_t)m;
+
+    /* Only the few values that would favour some results are drawn again */
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (uint64_t)(uint32_t)(nextRng(rng) >> 32) * bound;
+            low = (uint32_t)m;
+        }
+    }
+
+    return m >> 32;
+}
+
+#endif //RNG_H
@@ -0,0 +1,153 @@
+/* 
+ * sched.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include "sched.h"
+/* */
+
+/* Time helpers */
+static inline long long toNanos(const struct timespec *ts) {
+    return (long long)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static inline struct timespec fromNanos(long long ns) {
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    return ts;
+}
+/* */
+
+/* Function responsible of starting the scheduler, the first tick is due right away */
+void startScheduler(Scheduler *sched, long frameRate) {
+    resyncScheduler(sched);
+    sched->framePeriod = 1000000000L / frameRate;
+    sched->samples = 0;
+    sched->jitterSum = 0;
+    sched->jitterSumSq = 0;
+    sched->jitterMax = 0;
+    sched->skippedTicks = 0;
+}
+
+/* Function responsible of moving the deadlines to now, used when the loop was idle (menus) */
+void resyncScheduler(Scheduler *sched) {
+    clock_gettime(CLOCK_MONOTONIC, &sched->nextTick);
+    sched->nextFrame = sched->nextTick;
+    sched->waitingForTick = false;
+}
+
+/* Function responsible of sleeping until the next deadline or until fd can be read, returns whether it can.
+ * The frame deadline only counts if a frame is pending, and an idle loop only wakes up for input or a frame */
+bool schedulerSleep(Scheduler *sched, bool framePending, bool idle, int fd) {
+    long long tick = toNanos(&sched->nextTick);
+    long long frame = toNanos(&sched->nextFrame);
+    long long deadline = tick;
+
+    sched->waitingForTick = !idle;
+    if (framePending && (idle || frame < tick)) {
+        deadline = frame;
+        sched->waitingForTick = false;
+    }
+    bool forever = idle && !framePending;
+
+    /* The timeout is taken again from the absolute deadline after every interruption,
+     * so neither signals nor time spent working shift the next deadline */
+    struct pollfd input = { fd, POLLIN, 0 };
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long left = deadline - toNanos(&now);
+        struct timespec timeout = fromNanos(left > 0 ? left : 0);
+
+        int ready = ppoll(&input, 1, forever ? NULL : &timeout, NULL);
+        if (ready >= 0) return ready > 0;
+        if (errno != EINTR) return false;
+    }
+}
+
+/* Function responsible of returning how many ticks are due now, advancing the tick deadline */
+unsigned int schedulerTicksDue(Scheduler *sched, long tickPeriod) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long current = toNanos(&now);
+    long long tick = toNanos(&sched->nextTick);
+
+    if (current < tick) return 0;
+
+    /* Measure how late this wake-up was compared to the tick deadline */
+    if (sched->waitingForTick) {
+        long late = current - tick;
+        sched->samples++;
+        sched->jitterSum += late;
+        sched->jitterSumSq += (double)late * late;
+        if (late > sched->jitterMax) sched->jitterMax = late;
+        sched->waitingForTick = false;
+    }
+
+    /* Catch up on every missed deadline, but only up to a bound */
+    unsigned int due = 0;
+    while (tick <= current && due < MAX_CATCH_UP) {
+        tick += tickPeriod;
+        due++;
+    }
+
+    /* Too far behind, drop the backlog and start again from now */
+    if (tick <= current) {
+        sched->skippedTicks += (current - tick) / tickPeriod + 1;
+        tick = current + tickPeriod;
+    }
+
+    sched->nextTick = fromNanos(tick);
+    return due;
+}
+
+/* Function responsible of checking whether the frame rate cap allows drawing now */
+bool schedulerFrameDue(Scheduler *sched) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long current = toNanos(&now);
+    long long frame = toNanos(&sched->nextFrame);
+
+    if (current < frame) return false;
+
+    /* Frames are capped, not scheduled, so the next one is relative to this one */
+    sched->nextFrame = fromNanos(current + sched->framePeriod);
+    return true;
+}
+
+/* Function responsible of printing the measured tick jitter */
+void reportJitter(const Scheduler *sched, FILE *out) {
+    double mean = 0, deviation = 0;
+
+    if (sched->samples > 0) {
+        mean = sched->jitterSum / sched->samples;
+        double variance = sched->jitterSumSq / sched->samples - mean * mean;
+        deviation = variance > 0 ? sqrt(variance) : 0;
+    }
+
+    fprintf(out, "Tick jitter over %lu ticks: mean %.1f us, stddev %.1f us, max %.1f us, %lu ticks skipped\n",
+            sched->samples, mean / 1e3, deviation / 1e3, sched->jitterMax / 1e3, sched->skippedTicks);
+}
@@ -0,0 +1,34 @@
+#ifndef SCHED_H
+#define SCHED_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Scheduler constants */
+#define FRAME_RATE_CAP   60         /* maximum number of frames drawn per second */
+#define MAX_CATCH_UP     5          /* ticks simulated back to back before the backlog is dropped */
+/* */
+
+/* Fixed-timestep scheduler running on absolute monotonic deadlines */
+typedef struct Scheduler {
+    struct timespec nextTick;       /* deadline of the next simulation tick */
+    struct timespec nextFrame;      /* earliest time the next frame may be drawn */
+    long framePeriod;               /* minimum time between two frames, in nanoseconds */
+    bool waitingForTick;            /* the last sleep was for a tick deadline */
+    unsigned long samples;          /* tick wake-ups measured */
+    double jitterSum;               /* sum of the wake-up delays, in nanoseconds */
+    double jitterSumSq;             /* sum of the squared wake-up delays */
+    long jitterMax;                 /* worst wake-up delay, in nanoseconds */
+    unsigned long skippedTicks;     /* ticks dropped because the loop fell too far behind */
+} Scheduler;
+
+/* Function prototypes */
+void startScheduler(Scheduler *sched, long frameRate);
+void resyncScheduler(Scheduler *sched);
+bool schedulerSleep(Scheduler *sched, bool framePending, bool idle, int fd);
+unsigned int schedulerTicksDue(Scheduler *sched, long tickPeriod);
+bool schedulerFrameDue(Scheduler *sched);
+void reportJitter(const Scheduler *sched, FILE *out);
+/* */
+
+#endif //SCHED_H
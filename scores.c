@@ -0,0 +1,342 @@
+/* 
+ * scores.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "game.h"
+#include "scores.h"
+/* */
+
+/* Log header structure, the records follow it */
+typedef struct LogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;            /* sizeof(ScoreRecord), so a log from another build is refused */
+    uint32_t unused;
+} LogHeader;
+
+/* Function prototypes for the internal helpers */
+static ScoreStore *openReadOnly(const char *path);
+static char *indexPath(const char *path);
+static bool mapIndex(ScoreStore *store, uint32_t capacity, bool fresh);
+static void foldRecord(ScoreStore *store, const ScoreRecord *record);
+static SeedScore *seedSlot(ScoreIndex *index, uint64_t seed);
+static void growSeeds(ScoreStore *store);
+/* */
+
+/* Index helpers */
+static inline size_t indexBytes(uint32_t capacity) {
+    return sizeof(ScoreIndex) + (size_t)capacity * sizeof(SeedScore);
+}
+
+static inline SeedScore *indexSeeds(const ScoreIndex *index) {
+    return (SeedScore *)(index + 1);
+}
+/* */
+
+/* Function responsible of opening the score log and its index, creating both when they do not exist.
+ * The index lives next to the log with an .idx suffix and only ever needs the records it has not seen yet.
+ * Only one process at a time writes them, the others get a read-only store of the index as it is */
+ScoreStore *openScores(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return NULL;
+
+    /* The lock goes with the descriptor, it is held until closeScores closes the log */
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return errno == EWOULDBLOCK ? openReadOnly(path) : NULL;
+    }
+
+    /* A new log gets its header, an existing one has to be of this build */
+    struct stat info;
+    LogHeader header;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if (info.st_size == 0) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SCORES_LOG_MAGIC, 4);
+        header.version = SCORES_VERSION;
+        header.recordSize = sizeof(ScoreRecord);
+        if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+            close(fd);
+            return NULL;
+        }
+        info.st_size = sizeof(header);
+    } else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+               memcmp(header.magic, SCORES_LOG_MAGIC, 4) != 0 || header.version != SCORES_VERSION ||
+               header.recordSize != sizeof(ScoreRecord)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* Drop a record torn by a crash so the next ones stay aligned */
+    uint64_t logRecords = (info.st_size - sizeof(LogHeader)) / sizeof(ScoreRecord);
+    off_t whole = sizeof(LogHeader) + logRecords * sizeof(ScoreRecord);
+    if (info.st_size != whole && ftruncate(fd, whole) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    ScoreStore *store = calloc(1, sizeof(ScoreStore));
+    pthread_mutex_init(&store->lock, NULL);
+
+    /* Map the index, a missing or damaged one, or one ahead of the log after a crash, is built again */
+    char *indexFile = indexPath(path);
+    store->indexFd = open(indexFile, O_RDWR | O_CREAT, 0644);
+    free(indexFile);
+
+    bool valid = false;
+    if (store->indexFd >= 0 && fstat(store->indexFd, &info) == 0 && (size_t)info.st_size >= sizeof(ScoreIndex)) {
+        ScoreIndex index;
+        valid = pread(store->indexFd, &index, sizeof(index), 0) == sizeof(index) &&
+                memcmp(index.magic, SCORES_INDEX_MAGIC, 4) == 0 && index.version == SCORES_VERSION &&
+                index.seedCapacity > 0 && (index.seedCapacity & (index.seedCapacity - 1)) == 0 &&
+                (size_t)info.st_size == indexBytes(index.seedCapacity) && index.records <= logRecords &&
+                index.topCount <= SCORES_TOP && index.seedCount <= index.seedCapacity / 2;
+        valid = valid && mapIndex(store, index.seedCapacity, false);
+    }
+    if (!valid && (store->indexFd < 0 || !mapIndex(store, SCORES_SEEDS, true))) {
+        if (store->indexFd >= 0) close(store->indexFd);
+        pthread_mutex_destroy(&store->lock);
+        free(store);
+        close(fd);
+        return NULL;
+    }
+
+    /* Fold the records the index has not seen, a few at a time */
+    ScoreRecord chunk[256];
+    while (store->index->records < logRecords) {
+        uint64_t count = logRecords - store->index->records;
+        if (count > 256) count = 256;
+        off_t offset = sizeof(LogHeader) + store->index->records * sizeof(ScoreRecord);
+        if (pread(fd, chunk, count * sizeof(ScoreRecord), offset) != (ssize_t)(count * sizeof(ScoreRecord))) break;
+        for (uint64_t i = 0; i < count; i++) foldRecord(store, &chunk[i]);
+    }
+
+    /* Records are only gathered in memory and written a buffer at a time */
+    lseek(fd, 0, SEEK_END);
+    store->log = fdopen(fd, "ab");
+    setvbuf(store->log, NULL, _IOFBF, SCORES_BUFFER);
+    return store;
+}
+
+/* Function responsible of adding a finished game to the log and the index */
+void addScore(ScoreStore *store, const ScoreRecord *record) {
+    addScores(store, record, 1);
+}
+
+/* Function responsible of adding many finished games at once, taking the lock a single time */
+void addScores(ScoreStore *store, const ScoreRecord *records, size_t count) {
+    if (store->readOnly) return;
+
+    pthread_mutex_lock(&store->lock);
+    fwrite(records, sizeof(ScoreRecord), count, store->log);
+    for (size_t i = 0; i < count; i++) foldRecord(store, &records[i]);
+    pthread_mutex_unlock(&store->lock);
+}
+
+/* Function returning what the index knows about a seed, NULL when it was never played */
+const SeedScore *seedScore(const ScoreStore *store, uint64_t seed) {
+    /* The table of a read-only store is not mapped, the writer may grow it at any time */
+    if (store->readOnly) return NULL;
+
+    const SeedScore *slot = seedSlot(store->index, seed);
+    return slot->games > 0 ? slot : NULL;
+}
+
+/* Function responsible of writing out the buffered records and closing the store, the only sync it does */
+void closeScores(ScoreStore *store) {
+    if (!store->readOnly) {
+        fflush(store->log);
+        fsync(fileno(store->log));
+        fclose(store->log);
+        msync(store->index, store->indexSize, MS_SYNC);
+    }
+    munmap(store->index, store->indexSize);
+    close(store->indexFd);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+/* Function responsible of describing a finished game as a record */
+void makeScore(ScoreRecord *record, const GameState *state, uint64_t seed, uint64_t game, PlayerKind player,
+               uint32_t durationMs) {
+    memset(record, 0, sizeof(ScoreRecord));
+    record->seed = seed;
+    record->game = game;
+    record->ticks = state->ticks;
+    record->endTime = time(NULL);
+    record->durationMs = durationMs;
+    record->score = gameScore(state);
+    record->length = snakeSize(state);
+    record->width = state->board.width;
+    record->height = state->board.height;
+    record->player = player;
+    record->won = state->isWon;
+}
+
+/* Function returning the log in the home directory, NULL when there is no home */
+const char *defaultScoresPath() {
+    static char path[4096];
+    const char *home = getenv("HOME");
+    if (home == NULL || *home == '\0') return NULL;
+
+    snprintf(path, sizeof(path), "%s/%s", home, SCORES_FILE);
+    return path;
+}
+
+/* Function responsible of opening the index of a log another process holds, to read its top list.
+ * Only the header is mapped, it never moves when the writer grows the seed table behind it */
+static ScoreStore *openReadOnly(const char *path) {
+    char *indexFile = indexPath(path);
+    int fd = open(indexFile, O_RDONLY);
+    free(indexFile);
+    if (fd < 0) return NULL;
+
+    ScoreIndex header;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ScoreIndex) ||
+        pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, SCORES_INDEX_MAGIC, 4) != 0 ||
+        header.version != SCORES_VERSION || header.topCount > SCORES_TOP) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, sizeof(ScoreIndex), PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    ScoreStore *store = calloc(1, sizeof(ScoreStore));
+    pthread_mutex_init(&store->lock, NULL);
+    store->readOnly = true;
+    store->indexFd = fd;
+    store->index = data;
+    store->indexSize = sizeof(ScoreIndex);
+    return store;
+}
+
+/* Function returning the path of the index of a log, to be freed by the caller */
+static char *indexPath(const char *path) {
+    size_t length = strlen(path);
+    char *indexFile = malloc(length + 5);
+    memcpy(indexFile, path, length);
+    memcpy(indexFile + length, ".idx", 5);
+    return indexFile;
+}
+
+/* Function responsible of mapping the index with the given seed table size, a fresh one starts empty */
+static bool mapIndex(ScoreStore *store, uint32_t capacity, bool fresh) {
+    size_t size = indexBytes(capacity);
+
+    /* Truncating first also zeroes a fresh table, empty slots are all zero */
+    if (fresh && (ftruncate(store->indexFd, 0) != 0 || ftruncate(store->indexFd, size) != 0)) return false;
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, store->indexFd, 0);
+    if (data == MAP_FAILED) return false;
+
+    store->index = data;
+    store->indexSize = size;
+    if (fresh) {
+        memcpy(store->index->magic, SCORES_INDEX_MAGIC, 4);
+        store->index->version = SCORES_VERSION;
+        store->index->seedCapacity = capacity;
+    }
+    return true;
+}
+
+/* Function responsible of updating the index with the next record of the log */
+static void foldRecord(ScoreStore *store, const ScoreRecord *record) {
+    if ((store->index->seedCount + 1) * 2 > store->index->seedCapacity) growSeeds(store);
+
+    ScoreIndex *index = store->index;
+    uint64_t number = index->records++;
+
+    /* Per seed, the number of games and the best of them, a table that could not grow keeps one slot empty */
+    SeedScore *slot = seedSlot(index, record->seed);
+    if (slot->games > 0 || index->seedCount + 1 < index->seedCapacity) {
+        if (slot->games == 0) {
+            slot->seed = record->seed;
+            index->seedCount++;
+        }
+        if (slot->games++ == 0 || record->score > slot->bestScore) {
+            slot->bestScore = record->score;
+            slot->bestRecord = number;
+        }
+    }
+
+    /* The top list only moves when the game beats its last entry or the list is not full */
+    if (index->topCount == SCORES_TOP && record->score <= index->top[SCORES_TOP - 1].score) return;
+
+    uint32_t rank = index->topCount;
+    while (rank > 0 && index->top[rank - 1].score < record->score) rank--;
+    uint32_t moved = (index->topCount < SCORES_TOP ? index->topCount : SCORES_TOP - 1) - rank;
+    memmove(&index->top[rank + 1], &index->top[rank], moved * sizeof(ScoreRecord));
+    index->top[rank] = *record;
+    if (index->topCount < SCORES_TOP) index->topCount++;
+}
+
+/* Function returning the slot of a seed in the table, or the empty slot it would take */
+static SeedScore *seedSlot(ScoreIndex *index, uint64_t seed) {
+    SeedScore *seeds = indexSeeds(index);
+    uint32_t mask = index->seedCapacity - 1;
+    uint32_t slot = (uint32_t)((seed * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+
+    while (seeds[slot].games > 0 && seeds[slot].seed != seed) slot = (slot + 1) & mask;
+    return &seeds[slot];
+}
+
+/* Function responsible of doubling the seed table, the file grows and every seed is placed again */
+static void growSeeds(ScoreStore *store) {
+    uint32_t capacity = store->index->seedCapacity;
+    size_t bytes = (size_t)capacity * sizeof(SeedScore);
+    SeedScore *old = malloc(bytes);
+    memcpy(old, indexSeeds(store->index), bytes);
+
+    /* The header keeps its place, the table is zeroed and filled again */
+    munmap(store->index, store->indexSize);
+    if (ftruncate(store->indexFd, indexBytes(capacity * 2)) != 0 || !mapIndex(store, capacity * 2, false)) {
+        /* Out of disk, keep the old table and let it fill up further */
+        mapIndex(store, capacity, false);
+        free(old);
+        return;
+    }
+    store->index->seedCapacity = capacity * 2;
+    memset(indexSeeds(store->index), 0, (size_t)capacity * 2 * sizeof(SeedScore));
+    for (uint32_t i = 0; i < capacity; i++) {
+        if (old[i].games > 0) *seedSlot(store->index, old[i].seed) = old[i];
+    }
+    free(old);
+}
@@ -0,0 +1,88 @@
+#ifndef SCORES_H
+#define SCORES_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "game.h"
+
+/* Score store constants */
+#define SCORES_LOG_MAGIC "SSCL"     /* first bytes of the log */
+#define SCORES_INDEX_MAGIC "SSCI"   /* first bytes of the index */
+#define SCORES_VERSION   1          /* layout version of both files */
+#define SCORES_TOP       100        /* best games kept in the index */
+#define SCORES_SEEDS     1024       /* slots of a new per-seed table, doubled whenever it gets half full */
+#define SCORES_BUFFER    (64 * 1024) /* bytes of records gathered before they are written to the log */
+#define SCORES_BATCH     1024       /* records a batch worker gathers before it takes the store's lock */
+#define SCORES_FILE      ".serpent_scores"  /* log in the home directory when no other is given */
+/* */
+
+/* Who played a game */
+typedef enum {
+    PLAYER_HUMAN,
+    PLAYER_AUTOPILOT,               /* the pathfinding planner */
+    PLAYER_BOT,                     /* the greedy bot of --headless and --batch */
+    PLAYER_SEARCH,                  /* the tree search of --search */
+    PLAYER_KINDS
+} PlayerKind;
+
+/* Score record structure, one finished game as stored in the log, in the byte order of the machine */
+typedef struct ScoreRecord {
+    uint64_t seed;                  /* seed of the session, or of the batch */
+    uint64_t game;                  /* game of the session, or stream of the batch seed, it was played with */
+    uint64_t ticks;
+    uint64_t endTime;               /* seconds since the epoch when the game ended */
+    uint32_t durationMs;            /* wall clock time the game took */
+    int32_t score;
+    uint32_t length;
+    uint16_t width, height;
+    uint8_t player;                 /* PlayerKind */
+    uint8_t won;
+    uint8_t unused[6];
+} ScoreRecord;
+
+/* Seed score structure, what the index knows about every seed */
+typedef struct SeedScore {
+    uint64_t seed;
+    uint64_t games;                 /* games played with the seed, 0 for an empty slot */
+    uint64_t bestRecord;            /* log record of the best of them */
+    int32_t bestScore;
+    uint32_t unused;
+} SeedScore;
+
+/* Score index structure, the mapped file kept up to date with every record added.
+ * The per-seed table follows it, open addressing with linear probing over seedCapacity slots */
+typedef struct ScoreIndex {
+    char magic[4];
+    uint32_t version;
+    uint64_t records;               /* log records folded into the index */
+    uint64_t seedCount;             /* seeds in the table */
+    uint32_t seedCapacity;          /* slots in the table, a power of two */
+    uint32_t topCount;              /* games in top */
+    ScoreRecord top[SCORES_TOP];    /* best games, best first, earlier ones first among equal scores */
+} ScoreIndex;
+
+/* Score store structure, the open log and index.
+ * The store holds an exclusive lock on the log, every other process that opens it gets a read-only store */
+typedef struct ScoreStore {
+    bool readOnly;                  /* another process holds the log, only the index header is mapped to read */
+    FILE *log;                      /* appended to through a large buffer, never synced per record, NULL when read-only */
+    int indexFd;
+    ScoreIndex *index;              /* mapped index */
+    size_t indexSize;               /* bytes mapped */
+    pthread_mutex_t lock;           /* batch workers add their records from their own threads */
+} ScoreStore;
+
+/* Function prototypes */
+ScoreStore *openScores(const char *path);
+void addScore(ScoreStore *store, const ScoreRecord *record);
+void addScores(ScoreStore *store, const ScoreRecord *records, size_t count);
+const SeedScore *seedScore(const ScoreStore *store, uint64_t seed);
+void closeScores(ScoreStore *store);
+void makeScore(ScoreRecord *record, const GameState *state, uint64_t seed, uint64_t game, PlayerKind player,
+               uint32_t durationMs);
+const char *defaultScoresPath();
+/* */
+
+#endif //SCORES_H
@@ -0,0 +1,333 @@
+/* 
+ * search.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "game.h"
+#include "bot.h"
+#include "search.h"
+/* */
+
+/* Movement of each direction, indexed by Direction */
+static const int moveX[] = { 0, 0, -1, 1 };
+static const int moveY[] = { -1, 1, 0, 0 };
+static const Input turnInput[] = { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT };
+static const Direction opposite[] = { DOWN, UP, RIGHT, LEFT };
+/* */
+
+/* Function prototypes for the internal helpers */
+static void *workerMain(void *arg);
+static void searchTree(SearchWorker *worker);
+static uint32_t newNode(SearchWorker *worker);
+static double playRollout(SearchWorker *worker, double gathered, unsigned int tick);
+static Input randomInput(const GameState *state, Rng *rng);
+/* */
+
+/* Clock helper */
+static inline long long monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+/* */
+
+/* Function responsible of starting the worker pool of the search for boards of the given size */
+Searcher *startSearcher(int width, int height, unsigned int workers, RolloutKind rollout, unsigned int budget,
+                        uint64_t seed) {
+    if (workers < 1) workers = 1;
+    if (workers > SEARCH_MAX_WORKERS) workers = SEARCH_MAX_WORKERS;
+
+    Searcher *searcher = calloc(1, sizeof(Searcher));
+    searcher->workers = workers;
+    searcher->rollout = rollout;
+    searcher->budget = budget;
+    searcher->width = width;
+    searcher->height = height;
+
+    /* Rollouts go around the board once, so they see the traps the body leaves behind */
+    searcher->horizon = 2 * (width + height);
+    if (searcher->horizon < SEARCH_HORIZON) searcher->horizon = SEARCH_HORIZON;
+    if (searcher->horizon > SEARCH_HORIZON_MAX) searcher->horizon = SEARCH_HORIZON_MAX;
+
+    pthread_mutex_init(&searcher->lock, NULL);
+    pthread_cond_init(&searcher->start, NULL);
+    pthread_cond_init(&searcher->done, NULL);
+
+    /* Every worker gets its scratch game and node pool once, searching never allocates */
+    searcher->pool = calloc(workers, sizeof(SearchWorker));
+    for (unsigned int i = 0; i < workers; i++) {
+        SearchWorker *worker = &searcher->pool[i];
+        worker->searcher = searcher;
+        worker->id = i;
+        worker->scratch = startGame(width, height, seed);
+        worker->nodes = malloc(SEARCH_NODES * sizeof(SearchNode));
+        seedRng(&worker->rng, seed, i);
+        splitRng(&worker->rng, &worker->apples);
+    }
+    for (unsigned int i = 1; i < workers; i++) {
+        pthread_create(&searcher->pool[i].thread, NULL, workerMain, &searcher->pool[i]);
+    }
+
+    return searcher;
+}
+
+/* Function responsible of searching the game for the share of the tick given by its speed, returns the move to play */
+Input searchInput(Searcher *searcher, const GameState *state) {
+    if (!state->isAlive || state->isPaused) return INPUT_NONE;
+
+    /* The scratch games follow the food items of the game they copy, a resumed game may bring its own */
+    for (unsigned int i = 0; i < searcher->workers; i++) {
+        GameState *scratch = searcher->pool[i].scratch;
+        if (scratch->food.target != state->food.target) setFood(scratch, state->food.target);
+    }
+
+    /* Wake the helpers and search along with them until the deadline */
+    long long begin = monotonicNanos();
+    pthread_mutex_lock(&searcher->lock);
+    searcher->root = state;
+    searcher->deadline = begin + (long long)state->speed * SEARCH_TICK_NANOS * searcher->budget / 100;
+    searcher->running = searcher->workers - 1;
+    searcher->generation++;
+    pthread_cond_broadcast(&searcher->start);
+    pthread_mutex_unlock(&searcher->lock);
+
+    searchTree(&searcher->pool[0]);
+
+    pthread_mutex_lock(&searcher->lock);
+    while (searcher->running > 0) pthread_cond_wait(&searcher->done, &searcher->lock);
+    pthread_mutex_unlock(&searcher->lock);
+
+    /* Add up the first moves of every tree, the most visited one is played */
+    uint64_t visits[4] = { 0 };
+    double value[4] = { 0 };
+    for (unsigned int i = 0; i < searcher->workers; i++) {
+        const SearchWorker *worker = &searcher->pool[i];
+        for (int d = UP; d <= RIGHT; d++) {
+            uint32_t child = worker->nodes[0].child[d];
+            if (child == SEARCH_NONE) continue;
+            visits[d] += worker->nodes[child].visits;
+            value[d] += worker->nodes[child].value;
+        }
+        searcher->rollouts += worker->rollouts;
+        searcher->nodes += worker->nodeCount;
+    }
+    searcher->searches++;
+    searcher->seconds += (monotonicNanos() - begin) / 1e9;
+
+    int best = -1;
+    for (int d = UP; d <= RIGHT; d++) {
+        if (visits[d] == 0) continue;
+        if (best < 0 || visits[d] > visits[best] ||
+            (visits[d] == visits[best] && value[d] / visits[d] > value[best] / visits[best])) {
+            best = d;
+        }
+    }
+
+    /* A budget too small for a single rollout leaves the move to the greedy bot */
+    return best < 0 ? greedyInput(state) : turnInput[best];
+}
+
+/* Function responsible of printing how much searching was done */
+void reportSearch(const Searcher *searcher, FILE *out) {
+    double searches = searcher->searches > 0 ? searcher->searches : 1;
+    fprintf(out, "Search: %llu rollouts in %.3f s on %u workers with %s rollouts: %.0f rollouts/sec, "
+            "%.0f rollouts and %.0f nodes per tick\n",
+            searcher->rollouts, searcher->seconds, searcher->workers,
+            searcher->rollout == ROLLOUT_GREEDY ? "greedy" : "random",
+            searcher->seconds > 0 ? searcher->rollouts / searcher->seconds : 0.0,
+            searcher->rollouts / searches, searcher->nodes / searches);
+}
+
+/* Function responsible of stopping the worker pool and freeing the searcher */
+void freeSearcher(Searcher *searcher) {
+    pthread_mutex_lock(&searcher->lock);
+    searcher->stopping = true;
+    pthread_cond_broadcast(&searcher->start);
+    pthread_mutex_unlock(&searcher->lock);
+
+    for (unsigned int i = 0; i < searcher->workers; i++) {
+        if (i > 0) pthread_join(searcher->pool[i].thread, NULL);
+        freeGame(searcher->pool[i].scratch);
+        free(searcher->pool[i].nodes);
+    }
+    pthread_cond_destroy(&searcher->start);
+    pthread_cond_destroy(&searcher->done);
+    pthread_mutex_destroy(&searcher->lock);
+    free(searcher->pool);
+    free(searcher);
+}
+
+/* Function run by every helper worker: wait for a search, grow its own tree until the deadline, repeat */
+static void *workerMain(void *arg) {
+    SearchWorker *worker = arg;
+    Searcher *searcher = worker->searcher;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&searcher->lock);
+    for (;;) {
+        while (!searcher->stopping && searcher->generation == seen) {
+            pthread_cond_wait(&searcher->start, &searcher->lock);
+        }
+        if (searcher->stopping) break;
+        seen = searcher->generation;
+        pthread_mutex_unlock(&searcher->lock);
+
+        searchTree(worker);
+
+        pthread_mutex_lock(&searcher->lock);
+        if (--searcher->running == 0) pthread_cond_signal(&searcher->done);
+    }
+    pthread_mutex_unlock(&searcher->lock);
+    return NULL;
+}
+
+/* Function responsible of growing a tree from the root until the deadline, one node and one rollout per iteration.
+ * The tree is open loop: every iteration copies the root and plays the moves down the tree on the copy */
+static void searchTree(SearchWorker *worker) {
+    Searcher *searcher = worker->searcher;
+    const GameState *root = searcher->root;
+    GameState *scratch = worker->scratch;
+    uint32_t path[SEARCH_HORIZON + 1];
+
+    /* The pool is recycled, last tick's tree is simply forgotten */
+    worker->nodeCount = 0;
+    worker->rollouts = 0;
+    newNode(worker);
+
+    do {
+        copyGame(scratch, root);
+        /* The apples to come are not known, each iteration draws its own from a seed of the worker's apple stream.
+         * Seeding costs a few mixes where splitting the stream again would cost a 256-step jump */
+        seedRng(&scratch->rng, nextRng(&worker->apples), worker->id);
+
+        /* Walk down the tree, expanding the first move of a node not tried yet, else the one with the best bound */
+        double gathered = 0, discount = 1;
+        unsigned int depth = 0;
+        uint32_t node = 0;
+        path[0] = 0;
+        while (scratch->isAlive && depth < SEARCH_HORIZON) {
+            SearchNode *current = &worker->nodes[node];
+            Direction back = opposite[scratch->snake.direction];
+            int pick = -1;
+            bool expand = false;
+
+            for (int d = UP; d <= RIGHT && worker->nodeCount < SEARCH_NODES; d++) {
+                if (d != (int)back && current->child[d] == SEARCH_NONE) {
+                    pick = d;
+                    expand = true;
+                    break;
+                }
+            }
+            if (pick < 0) {
+                double logVisits = log(current->visits);
+                double bestBound = -1;
+                for (int d = UP; d <= RIGHT; d++) {
+                    if (d == (int)back || current->child[d] == SEARCH_NONE) continue;
+                    const SearchNode *child = &worker->nodes[current->child[d]];
+                    double bound = child->value / child->visits + SEARCH_EXPLORATION * sqrt(logVisits / child->visits);
+                    if (bound > bestBound) {
+                        bestBound = bound;
+                        pick = d;
+                    }
+                }
+            }
+            /* The pool ran out before this node got children, a rollout from here is all that is left */
+            if (pick < 0) break;
+
+            if (expand) current->child[pick] = newNode(worker);
+            node = current->child[pick];
+            path[++depth] = node;
+
+            unsigned int grown = scratch->snake.length + scratch->snake.growth;
+            stepGame(scratch, turnInput[pick]);
+            discount *= SEARCH_DISCOUNT;
+            if (scratch->snake.length + scratch->snake.growth > grown) gathered += discount;
+            if (expand) break;
+        }
+
+        /* Play the rest of the horizon and credit every node on the way down */
+        double value = playRollout(worker, gathered, depth);
+        for (unsigned int i = 0; i <= depth; i++) {
+            worker->nodes[path[i]].visits++;
+            worker->nodes[path[i]].value += value;
+        }
+        worker->rollouts++;
+    } while (monotonicNanos() < searcher->deadline);
+}
+
+/* Function responsible of taking a node from the pool, SEARCH_NONE when it is used up */
+static uint32_t newNode(SearchWorker *worker) {
+    if (worker->nodeCount == SEARCH_NODES) return SEARCH_NONE;
+
+    SearchNode *node = &worker->nodes[worker->nodeCount];
+    for (int d = UP; d <= RIGHT; d++) node->child[d] = SEARCH_NONE;
+    node->visits = 0;
+    node->value = 0;
+    return worker->nodeCount++;
+}
+
+/* Function responsible of playing the scratch game to the horizon, returns a value between 0 and 1.
+ * Staying alive is worth half of it, the apples eaten on the way, sooner being better, the other half */
+static double playRollout(SearchWorker *worker, double gathered, unsigned int tick) {
+    Searcher *searcher = worker->searcher;
+    GameState *state = worker->scratch;
+    double discount = pow(SEARCH_DISCOUNT, tick);
+
+    while (state->isAlive && tick < searcher->horizon) {
+        Input input;
+        if (searcher->rollout == ROLLOUT_GREEDY && boundedRng(&worker->rng, SEARCH_EPSILON) != 0) {
+            input = greedyInput(state);
+        } else {
+            input = randomInput(state, &worker->rng);
+        }
+
+        unsigned int grown = state->snake.length + state->snake.growth;
+        stepGame(state, input);
+        tick++;
+        discount *= SEARCH_DISCOUNT;
+        if (state->snake.length + state->snake.growth > grown) gathered += discount;
+    }
+
+    double survival = state->isAlive || state->isWon ? 1.0 : (double)tick / searcher->horizon;
+    return 0.5 * survival + 0.5 * (gathered < 1.0 ? gathered : 1.0);
+}
+
+/* Function responsible of picking any move that does not die on the next tick */
+static Input randomInput(const GameState *state, Rng *rng) {
+    Position *head = snakeSegment(state, 0);
+    Input moves[3];
+    unsigned int count = 0;
+
+    for (int d = UP; d <= RIGHT; d++) {
+        if (d == (int)opposite[state->snake.direction]) continue;
+        int x = head->pX + moveX[d], y = head->pY + moveY[d];
+        wrapCell(&state->board, &x, &y);
+        if (!cellBlocked(state, x, y)) moves[count++] = turnInput[d];
+    }
+
+    /* When every move is deadly keep going, the rollout is over anyway */
+    return count == 0 ? INPUT_NONE : moves[boundedRng(rng, count)];
+}
@@ -0,0 +1,81 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "game.h"
+
+/* Search constants */
+#define SEARCH_NODES     (1 << 16)  /* tree nodes of each worker, reused on every tick */
+#define SEARCH_BUDGET    50         /* default share of a tick spent searching, in percent */
+#define SEARCH_TICK_NANOS 800000L   /* nanoseconds of a tick per unit of speed, as in the game loop */
+#define SEARCH_HORIZON   64         /* shortest rollout, and deepest tree, longer rollouts go around the board once */
+#define SEARCH_HORIZON_MAX 512      /* longest rollout, whatever the board size */
+#define SEARCH_EXPLORATION 0.2      /* weight of the exploration term of the tree policy, values are between 0 and 1 */
+#define SEARCH_DISCOUNT  0.9        /* value of an apple eaten one tick later, steep enough to not dawdle */
+#define SEARCH_EPSILON   8          /* one in this many moves of a greedy rollout is random */
+#define SEARCH_MAX_WORKERS 64
+#define SEARCH_TICKS     1000       /* default number of ticks simulated by --search with --headless */
+#define SEARCH_NONE      UINT32_MAX /* child that was not expanded yet */
+/* */
+
+/* How rollouts pick their moves */
+typedef enum {
+    ROLLOUT_RANDOM,                 /* any move that does not die on the next tick */
+    ROLLOUT_GREEDY                  /* the greedy bot, with a random move now and then */
+} RolloutKind;
+
+/* Search node structure, the moves made from the root up to it are its state.
+ * Apples are drawn again on every rollout, so a node stands for every game those moves lead to */
+typedef struct SearchNode {
+    uint32_t child[4];              /* node reached by each Direction, SEARCH_NONE when not expanded */
+    uint32_t visits;
+    float value;                    /* sum of the rollout values that went through the node */
+} SearchNode;
+
+struct Searcher;
+
+/* Search worker structure, a tree of its own grown from the same root as the others */
+typedef struct SearchWorker {
+    pthread_t thread;
+    struct Searcher *searcher;
+    unsigned int id;
+    GameState *scratch;             /* copy of the root every iteration plays on */
+    SearchNode *nodes;              /* node pool, emptied at the start of every search */
+    uint32_t nodeCount;
+    Rng rng;                        /* moves of the random rollouts */
+    Rng apples;                     /* seeds of the apples of every iteration, split off rng once */
+    unsigned long rollouts;         /* rollouts of the current search */
+} SearchWorker;
+
+/* Searcher structure, the worker pool and what it is searching */
+typedef struct Searcher {
+    unsigned int workers;           /* worker 0 is the calling thread */
+    RolloutKind rollout;
+    unsigned int budget;            /* share of a tick spent searching, in percent */
+    int width, height;
+    SearchWorker *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long generation;       /* bumped to start a search */
+    unsigned int running;           /* helper workers still searching */
+    bool stopping;
+    const GameState *root;
+    long long deadline;             /* monotonic time the search ends at */
+    unsigned int horizon;           /* ticks played by a rollout */
+    unsigned long long rollouts;    /* totals for reportSearch */
+    unsigned long long nodes;
+    unsigned long searches;
+    double seconds;
+} Searcher;
+
+/* Function prototypes */
+Searcher *startSearcher(int width, int height, unsigned int workers, RolloutKind rollout, unsigned int budget,
+                        uint64_t seed);
+Input searchInput(Searcher *searcher, const GameState *state);
+void reportSearch(const Searcher *searcher, FILE *out);
+void freeSearcher(Searcher *searcher);
+/* */
+
+#endif //SEARCH_H
@@ -22,439 +22,580 @@
 /* Libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <time.h>
 #include <unistd.h>
 #include <ncurses.h>
 #include "serpent.h"
+#include "sched.h"
+#include "headless.h"
+#include "batch.h"
+#include "arena.h"
+#include "replay.h"
+#include "server.h"
+#include "snapshot.h"
+#include "render.h"
+#include "stats.h"
+#include "input.h"
+#include "planner.h"
+#include "scores.h"
+#include "search.h"
+#include "regions.h"
+#include "level.h"
 /* */
 
 /* Global variables */
-bool isAlive = true;                  /* variable to check if snake is alive */
-bool isPaused = false;                /* variable to check if the game is paused */
-const unsigned int minSpeed = 100;    /* default speed of the game (lower is faster) */
-const unsigned int maxSpeed = 70;     /* max speed of the game (lower is faster) */
-unsigned int speed = minSpeed;        /* variable speed of the game (lower is faster) */
-unsigned int terminalRows;            /* variable for storing the terminal rows */
-unsigned int terminalCols;            /* variable for storing the terminal columns */
-int startY;                           /* initial Y position of the window */
-int startX;                           /* initial X position of the window */
+GameState *game;                      /* the game being played */
 unsigned int score;                   /* game score */
-/* */
-
-/* Initialize structs */
-Snake *snake;
-Apple *apple;
+bool framePending = false;            /* the game changed since the last frame was drawn */
+bool showJitter = false;              /* print the tick jitter on exit */
+bool showStats = false;               /* print the phase timings on exit */
+bool keyPending = false;              /* a key was read and its effect is not on the screen yet */
+long long keyTime;                    /* when that key was read */
+Scheduler scheduler;                  /* tick and frame deadlines */
+Recorder *recorder = NULL;            /* inputs are being recorded to a file */
+Replay *replay = NULL;                /* inputs come from a recording instead of the keyboard */
+TurnQueue turns;                      /* turns typed ahead, applied one per tick */
+Planner *planner = NULL;              /* the autopilot plays instead of the keyboard */
+Searcher *searcher = NULL;            /* the tree search plays instead of the keyboard */
+Regions *regions = NULL;              /* free space kept up to date for the trap warning */
+const Level *level = NULL;            /* level the games are played on instead of the empty box */
+const char *savePath = NULL;          /* where the game is saved when asked to */
+const Snapshot *resume = NULL;        /* saved game the first game continues from */
+ScoreStore *scores = NULL;            /* where finished games are recorded */
+uint64_t sessionSeed;                 /* seed the session started from */
+uint64_t gamesPlayed = 0;             /* games finished in this session */
 /* */
 
 int main (int argc, char **argv) {
     /* Command line parsing */
     int option;
 
-    static const char* shortOptions = "chv";
+    bool headless = false;
+    bool autopilot = false;
+    bool search = false;
+    bool traps = false;
+    RolloutKind rollout = ROLLOUT_GREEDY;
+    unsigned long budget = SEARCH_BUDGET;
+    unsigned long batch = 0;
+    unsigned long arena = 0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int workers = cores < 1 ? 1 : cores;     /* sysconf gives -1 when it can not tell */
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    const char *tracePath = NULL;
+    const char *resumePath = NULL;
+    const char *servePath = NULL;
+    const char *scoresPath = NULL;
+    const char *levelPath = NULL;
+    const char *compilePath = NULL;
+    unsigned long ticks = 0;
+    unsigned long food = 0;
+    uint64_t seed = time(NULL);
+    int width = SCREEN_WIDTH;
+    int height = SCREEN_HEIGHT;
+
+    static const char* shortOptions = "ab:chjr:R:s:St:vw:";
     static struct option longOptions[] = {
+        {"arena", required_argument, NULL, 'A'},
+        {"autopilot", no_argument, NULL, 'a'},
+        {"batch", required_argument, NULL, 'b'},
+        {"budget", required_argument, NULL, 'G'},
+        {"compile-level", required_argument, NULL, 'C'},
         {"show-controls", no_argument, NULL, 'c'},
         {"help", no_argument, NULL, 'h'},
+        {"food", required_argument, NULL, 'O'},
+        {"headless", no_argument, NULL, 'H'},
+        {"height", required_argument, NULL, 'Y'},
+        {"jitter", no_argument, NULL, 'j'},
+        {"level", required_argument, NULL, 'Q'},
+        {"record", required_argument, NULL, 'r'},
+        {"render", required_argument, NULL, 'D'},
+        {"replay", required_argument, NULL, 'R'},
+        {"resume", required_argument, NULL, 'U'},
+        {"rollout", required_argument, NULL, 'N'},
+        {"save", required_argument, NULL, 'F'},
+        {"scores", required_argument, NULL, 'K'},
+        {"search", no_argument, NULL, 'M'},
+        {"seed", required_argument, NULL, 's'},
+        {"serve", required_argument, NULL, 'E'},
+        {"stats", no_argument, NULL, 'S'},
+        {"ticks", required_argument, NULL, 't'},
+        {"trace", required_argument, NULL, 'T'},
+        {"traps", no_argument, NULL, 'W'},
         {"version", no_argument, NULL, 'v'},
+        {"width", required_argument, NULL, 'X'},
+        {"workers", required_argument, NULL, 'w'},
         {NULL, 0, NULL, 0}
     };
 
     while ((option = getopt_long (argc, argv, shortOptions, longOptions, NULL)) != -1) {
         switch (option) {
+            case 'a':
+                autopilot = true;
+                break;
+            case 'A':
+                arena = strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                batch = strtoul(optarg, NULL, 10);
+                break;
+            case 'G':
+                budget = strtoul(optarg, NULL, 10);
+                break;
             case 'c':
                 argControls();
                 return 0;
             case 'h':
                 argHelp();
                 return 0;
+            case 'H':
+                headless = true;
+                break;
+            case 'O':
+                food = strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                showJitter = true;
+                break;
+            case 'r':
+                recordPath = optarg;
+                break;
+            case 'D':
+                renderer = findRenderer(optarg);
+                if (renderer == NULL) {
+                    fprintf(stderr, "ERROR: Unknown renderer '%s', use curses or ansi.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'R':
+                replayPath = optarg;
+                break;
+            case 'F':
+                savePath = optarg;
+                break;
+            case 'K':
+                scoresPath = optarg;
+                break;
+            case 'U':
+                resumePath = optarg;
+                break;
+            case 'Q':
+                levelPath = optarg;
+                break;
+            case 'C':
+                compilePath = optarg;
+                break;
+            case 'N':
+                if (strcmp(optarg, "random") == 0) rollout = ROLLOUT_RANDOM;
+                else if (strcmp(optarg, "greedy") == 0) rollout = ROLLOUT_GREEDY;
+                else {
+                    fprintf(stderr, "ERROR: Unknown rollout '%s', use greedy or random.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'M':
+                search = true;
+                break;
+            case 'W':
+                traps = true;
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'E':
+                servePath = optarg;
+                break;
+            case 'S':
+                showStats = true;
+                break;
+            case 't':
+                ticks = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                tracePath = optarg;
+                break;
             case 'v':
                 argVersion();
                 return 0;
+            case 'w':
+                workers = strtoul(optarg, NULL, 10);
+                break;
+            case 'X':
+                width = strtol(optarg, NULL, 10);
+                break;
+            case 'Y':
+                height = strtol(optarg, NULL, 10);
+                break;
             case '?':
                 fprintf(stderr, "Use '-h, --help' for help.\n");
                 return 1;
         }
     }
 
-    if ((initializeGame()) == 1) return 1;
-
-    cleanup();
-
-    return 0;
-}
-
-/* Function responsible of initializing the snake strucutre */
-Snake *startSnake() {
-    /* Allocate memory for a new snake */
-    Snake *new_snake = malloc(sizeof(Snake));
-    
-    /* Allocate memory for the head of the snake */
-    SnakeNode *head = malloc(sizeof(SnakeNode));
-    
-    /* Initialize the snake's head and tail to the allocated head node */
-    new_snake->head = head;
-    new_snake->tail = head;
-    
-    /* Set the head's previous and next pointers to NULL, as it's the only node in the beginning */
-    head->prev = NULL;
-    head->next = NULL;
-    
-    /* Set the initial position of the snake's head at the center of the board */
-    head->pX = SCREEN_WIDTH / 2;
-    head->pY = SCREEN_HEIGHT / 2;
-    
-    /* Initialize a node pointer to the head for iterating through the snake's body */
-    SnakeNode *node = head;
-
-    /* Create additional nodes to form the initial snake body */
-    for (int i = 1; i < START_SNAKE_SIZE; i++) {
-        /* Add a new node to the snake, updating the node pointer */
-        appendSnakeNode(new_snake);
-        node = node->next;
-
-        /* Copy the position of the previous node to maintain a straight line */
-        node->pX = node->prev->pX;
-        node->pY = node->prev->pY + 1;
-    }
-    
-    /* Set the initial direction of the snake to move upward */
-    new_snake->direction = UP;
-    
-    /* Return the initialized snake */
-    return new_snake;
-}
-
-/* Function responsible of initializing the apple structure */
-Apple *startApple() {
-    /* Allocate memory for a new apple */
-    Apple *new_apple = malloc(sizeof(Apple));
-
-    /* Seed the random number generator with the current time */
-    srand(time(NULL));
-
-    /* Generate random coordinates for the new apple, ensuring it does not overlap with the snake */
-    do {
-        new_apple->pX = (random() % (SCREEN_WIDTH - 2)) + 1;
-        new_apple->pY = (random() % (SCREEN_HEIGHT - 2)) + 1;
-    } while (snakeCollision(new_apple->pX, new_apple->pY, false));
-
-    /* Return the initialized apple */
-    return new_apple;
-}
-
-/* Function responsible of adding a new node to the tail of the snake */
-void appendSnakeNode(Snake *new_snake) {
-    /* Allocate memory for a new snake node */
-    SnakeNode *node_ptr = malloc(sizeof(SnakeNode));
-    
-    /* Set the previous pointer of the new node to the current tail of the snake */
-    node_ptr->prev = new_snake->tail;
-    
-    /* The new node is the last in the linked list, so its next pointer is NULL */
-    node_ptr->next = NULL;
-    
-    /* Connect the current tail's next pointer to the new node */
-    new_snake->tail->next = node_ptr;
-
-    /* Update the snake's tail to point to the new node, making it the new tail */
-    new_snake->tail = node_ptr;
-}
-
-/* Function responsible of freeing the memory for the snake structure */
-void freeSnake() {
-    /* Initialize pointers to traverse the snake linked list */
-    SnakeNode *snake_current = snake->head;
-    SnakeNode *snake_next = snake->head->next;
-
-    /* Traverse the snake linked list and free each node */
-    while (snake_next != NULL) {
-        /* Free the current node */
-        free(snake_current);
+    /* Turn a level source into a level file and stop, mapping the result checks it the way a game would */
+    if (compilePath != NULL) {
+        if (levelPath == NULL) {
+            fprintf(stderr, "ERROR: Give the level file to write with --level.\n");
+            return 1;
+        }
+        if (!compileLevel(compilePath, levelPath, stderr)) return 1;
+        const Level *compiled = mapLevel(levelPath);
+        if (compiled == NULL) {
+            fprintf(stderr, "ERROR: Could not read the level '%s' back.\n", levelPath);
+            return 1;
+        }
+        printf("Compiled a %dx%d level into '%s'.\n", compiled->width, compiled->height, levelPath);
+        unmapLevel(compiled);
+        return 0;
+    }
 
-        /* Move to the next node */
-        snake_current = snake_next;
-        snake_next = snake_next->next;
+    /* A level decides the board size. Only games of the single player engine are built on it,
+     * and recordings and saved games keep the seed and the board but not the level */
+    if (levelPath != NULL) {
+        if (arena > 0 || servePath != NULL || replayPath != NULL || recordPath != NULL || resumePath != NULL) {
+            fprintf(stderr, "ERROR: Levels can not be played with --arena, --serve, --record, --replay or --resume.\n");
+            return 1;
+        }
+        level = mapLevel(levelPath);
+        if (level == NULL) {
+            fprintf(stderr, "ERROR: Could not read the level '%s'.\n", levelPath);
+            return 1;
+        }
+        width = level->width;
+        height = level->height;
     }
 
-    /* Free the last node */
-    free(snake_current);
+    /* Boards are limited by the 16-bit positions and by the starting snake */
+    if (width < MIN_BOARD_SIZE || width > MAX_BOARD_SIZE || height < MIN_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+        fprintf(stderr, "ERROR: The board sides must be between %d and %d.\n", MIN_BOARD_SIZE, MAX_BOARD_SIZE);
+        return 1;
+    }
 
-    /* Free the snake structure itself */
-    free(snake);
+    /* Only the games played in the terminal are recorded */
+    if (recordPath != NULL && (headless || batch > 0 || arena > 0 || servePath != NULL)) {
+        fprintf(stderr, "ERROR: Games can not be recorded with --headless, --batch, --arena or --serve.\n");
+        return 1;
+    }
 
-    /* Set the global snake pointer to NULL to avoid dangling references */
-    snake = NULL;
-}
+    /* Food items are only kept by the games of the terminal and of --headless */
+    if (food > 0 && (batch > 0 || arena > 0 || servePath != NULL)) {
+        fprintf(stderr, "ERROR: Food items can not be played with --batch, --arena or --serve.\n");
+        return 1;
+    }
 
-/* Function responsible of saving the size of the snake */
-int snakeSize() {
-    /* Initialize a pointer to traverse the snake linked list */
-    SnakeNode *snake_ptr = snake->head;
+    /* Food items only go on free cells, a quarter of the board keeps room for the snake */
+    if (food > (unsigned long)width * height / 4) {
+        fprintf(stderr, "ERROR: At most %d food items fit on this board.\n", width * height / 4);
+        return 1;
+    }
 
-    /* Initialize a counter to keep track of the number of nodes in the snake linked list */
-    int counter = 0;
+    /* Many snakes share one board, each needs some room to be placed on it */
+    if (arena > ARENA_MAX_SNAKES || arena > (unsigned long)width * height / ARENA_CELLS_PER_SNAKE) {
+        fprintf(stderr, "ERROR: At most %lu snakes fit in an arena of this size.\n",
+                (unsigned long)width * height / ARENA_CELLS_PER_SNAKE < ARENA_MAX_SNAKES
+                ? (unsigned long)width * height / ARENA_CELLS_PER_SNAKE : ARENA_MAX_SNAKES);
+        return 1;
+    }
 
-    /* Traverse the snake linked list and count each node */
-    while (snake_ptr != NULL) {
-        counter++;
+    /* Only one controller can play instead of the keyboard, and it needs some time to search */
+    if (search && autopilot) {
+        fprintf(stderr, "ERROR: The autopilot and the search can not play together.\n");
+        return 1;
+    }
+    if (budget < 1 || budget > 100) {
+        fprintf(stderr, "ERROR: The search budget is a share of the tick between 1 and 100.\n");
+        return 1;
+    }
 
-        /* Move to the next node */
-        snake_ptr = snake_ptr->next;
+    /* Step a crowd of bots as fast as possible, or play against them */
+    if (arena > 0 && headless) {
+        runArena(arena, ticks ? ticks : ARENA_TICKS, workers, seed, width, height, stdout);
+        return 0;
+    }
+    if (arena > 0) return playArena(arena, seed, width, height);
+
+    /* Play many independent games over a pool of workers */
+    if (batch > 0) {
+        if (!openBotScores(scoresPath)) return 1;
+        runBatch(batch, workers, seed, width, height, level, scores, stdout);
+        if (scores != NULL) closeScores(scores);
+        return 0;
     }
 
-    /* Return the total size of the snake, which is the number of nodes in the linked list */
-    return counter;
-}
+    /* Host a game for every client of the socket, without a terminal */
+    if (servePath != NULL) return runServer(servePath, seed, width, height, stdout);
 
-/* Function responsible of handling the snake's movement */
-void updateSnake() {
-    /* Check if the snake is moving (either horizontally or vertically) */
-    if ((ABS(snake->direction == LEFT ? -1 : snake->direction == RIGHT ? 1 : 0) > 0) ||
-        (ABS(snake->direction == UP ? -1 : snake->direction == DOWN ? 1 : 0) > 0)) {
-        /* Calculate the new coordinates for the head and tail of the snake */
-        int new_head_x = snake->head->pX + (snake->direction == LEFT ? -1 : snake->direction == RIGHT ? 1 : 0);
-        int new_head_y = snake->head->pY + (snake->direction == UP ? -1 : snake->direction == DOWN ? 1 : 0);
-        int new_tail_x = snake->tail->pX + (snake->direction == LEFT ? -1 : snake->direction == RIGHT ? 1 : 0);
-        int new_tail_y = snake->tail->pY + (snake->direction == UP ? -1 : snake->direction == DOWN ? 1 : 0);
-
-        /* Check if the new head position does not overlap with an apple */
-        if (!appleCollision(new_head_x, new_head_y)) {
-            /* Move the tail to the new head position */
-            snake->tail->pX = new_head_x;
-            snake->tail->pY = new_head_y;
-
-            /* Adjust the linked list to maintain the snake's continuity */
-            snake->tail->next = snake->head;
-            snake->head->prev = snake->tail;
-            snake->tail = snake->tail->prev;
-            snake->tail->next = NULL;
-            snake->head->prev->prev = NULL;
-            snake->head = snake->head->prev;
-        } else {
-            /* If the head overlaps with an apple (the snake ate an apple), move the apple to a new position */
-            updateApple();
-
-            /* Increase the speed if it hasn't reached the maximum */
-            if (speed >= maxSpeed) {
-                speed -= 1;
-            }
+    /* Load the recording to play back, it also decides the seed and the board size */
+    if (replayPath != NULL) {
+        replay = openReplay(replayPath);
+        if (replay == NULL) {
+            fprintf(stderr, "ERROR: Could not read the recording '%s', it is missing or corrupt.\n", replayPath);
+            return 1;
+        }
 
-            /* Create a new head node and update its position */
-            SnakeNode *new_head = malloc(sizeof(SnakeNode));
-            new_head->pX = new_head_x;
-            new_head->pY = new_head_y;
-            new_head->prev = NULL;
-            new_head->next = snake->head;
+        /* Fast-forward through the recording without a terminal */
+        if (headless) {
+            runReplayHeadless(replay, stdout);
+            closeReplay(replay);
+            return 0;
+        }
 
-            /* Update the linked list to include the new head */
-            snake->head->prev = new_head;
-            snake->head = new_head;
+        seed = replay->seed;
+        width = replay->width;
+        height = replay->height;
+    }
 
-            /* Add a new node to the snake's body */
-            appendSnakeNode(snake);
+    /* Recordings only hold the seed and the inputs, the food items would not come back the same */
+    if (food > 0 && (replayPath != NULL || recordPath != NULL)) {
+        fprintf(stderr, "ERROR: Games with food items can not be recorded or replayed.\n");
+        return 1;
+    }
 
-            /* Set the position for the tail node */
-            snake->tail->pX = new_tail_x;
-            snake->tail->pY = new_tail_y;
+    /* Continue a saved game, it decides the board size and the food items.
+     * Recordings start from a seed so they can not follow it */
+    if (resumePath != NULL) {
+        if (replayPath != NULL || recordPath != NULL || headless) {
+            fprintf(stderr, "ERROR: A saved game can not be recorded, replayed or run headless.\n");
+            return 1;
         }
-
-        /* Check for collision with the game borders or itself */
-        if (snakeCollision(new_head_x, new_head_y, false) ||
-            (new_head_x == 0) || (new_head_x == SCREEN_WIDTH - 1) ||
-            (new_head_y == 0) || (new_head_y == SCREEN_HEIGHT - 1)) {
-            /* If there is a collision, set the snake as not alive */
-            isAlive = false;
+        resume = mapSnapshot(resumePath);
+        if (resume == NULL) {
+            fprintf(stderr, "ERROR: Could not read the saved game '%s'.\n", resumePath);
+            return 1;
         }
+        width = resume->width;
+        height = resume->height;
     }
-}
 
-/* Function responsible of moving the apple to a new position */
-void updateApple() {
-    /* Variables to store the new coordinates for the apple */
-    int new_x, new_y;
-
-    /* Generate new random coordinates for the apple, ensuring it does not overlap with the snake */
-    do {
-        new_x = (random() % (SCREEN_WIDTH - 2)) + 1;
-        new_y = (random() % (SCREEN_HEIGHT - 2)) + 1;
-    } while (snakeCollision(new_x, new_y, true));
-
-    /* Update the position of the existing apple to the new coordinates */
-    apple->pX = new_x;
-    apple->pY = new_y;
-}
+    /* Record the inputs of every game played in this session */
+    if (recordPath != NULL) {
+        recorder = startRecording(recordPath, seed, width, height);
+        if (recorder == NULL) {
+            fprintf(stderr, "ERROR: Could not create the recording '%s'.\n", recordPath);
+            return 1;
+        }
+    }
 
-/* Function responsible of checking if the snake collided with itself */
-bool snakeCollision(int x, int y, bool excludeHead) {
-    /* Initialize a pointer to traverse the snake linked list */
-    SnakeNode *snake_ptr;
+    /* Run the simulation alone, as fast as possible, without touching the terminal */
+    if (headless) {
+        if (!openBotScores(scoresPath)) return 1;
+        if (search) searcher = startSearcher(width, height, workers, rollout, budget, seed);
+        runHeadless(ticks ? ticks : search ? SEARCH_TICKS : HEADLESS_TICKS, seed, width, height, level, food,
+                    autopilot, searcher, scores, stdout);
+        if (searcher != NULL) freeSearcher(searcher);
+        if (scores != NULL) closeScores(scores);
+        return 0;
+    }
 
-    /* Determine the starting point in the linked list based on whether the head should be excluded */
-    if (excludeHead) {
-        snake_ptr = snake->head;
-    } else {
-        snake_ptr = snake->head->next;
+    /* Time the phases of the game loop, only when asked as it costs a clock read per phase */
+    if ((showStats || tracePath != NULL) && !startStats(tracePath)) {
+        fprintf(stderr, "ERROR: Could not create the trace '%s'.\n", tracePath);
+        return 1;
     }
 
-    /* Traverse the snake linked list */
-    while (snake_ptr != NULL) {
-        /* Check if the current node's position matches the specified coordinates */
-        if (snake_ptr->pX == x && snake_ptr->pY == y) {
-            /* The snake occupies the specified position */
-            return true;
+    /* Keep the games played by hand, the home directory holds them unless told otherwise */
+    if (replay == NULL) {
+        const char *path = scoresPath != NULL ? scoresPath : defaultScoresPath();
+        if (path != NULL) scores = openScores(path);
+        if (scores == NULL && scoresPath != NULL) {
+            fprintf(stderr, "ERROR: Could not open the score log '%s'.\n", scoresPath);
+            return 1;
+        }
+        if (scores == NULL && path != NULL) fprintf(stderr, "WARNING: Could not open the score log '%s'.\n", path);
+        if (scores != NULL && scores->readOnly) {
+            fprintf(stderr, "WARNING: The score log '%s' is in use by another game, this one is not recorded.\n", path);
         }
-
-        /* Move to the next node */
-        snake_ptr = snake_ptr->next;
     }
+    sessionSeed = seed;
 
-    /* The snake does not occupy the specified position */
-    return false;
-}
+    /* The search keeps its workers between ticks, they only wake up to search */
+    if (search && replay == NULL) searcher = startSearcher(width, height, workers, rollout, budget, seed);
 
-/* Function to chech if the snake ate an apple */
-bool appleCollision(int x, int y) {
-    /* Check if the specified coordinates match the position of the apple */
-    if (apple->pX == x && apple->pY == y) {
-        /* The apple occupies the specified position */
-        return true;
-    }
+    if ((initializeGame(seed, width, height, food, autopilot && replay == NULL, traps)) == 1) return 1;
+
+    cleanup();
+
+    /* Report how closely the ticks followed their deadlines */
+    if (showJitter) reportJitter(&scheduler, stderr);
+
+    /* Report where the time of each tick went */
+    if (showStats) reportStats(stderr);
+    stopStats();
 
-    /* The apple does not occupy the specified position */
-    return false;
+    return 0;
 }
 
 /* Function responsible of handling user input */
 void handleInput(int key) {
-    /* Handle different key inputs to change the snake's direction */
+    Input input;
+
+    /* Translate the key into a game input */
     switch (key) {
         case KEY_UP:
-            if (isPaused) isPaused = !isPaused;
-            /* If the snake is not currently moving down, change its direction to up */
-            if (snake->direction != DOWN) snake->direction = UP;
+            input = INPUT_UP;
             break;
         case KEY_DOWN:
-            if (isPaused) isPaused = !isPaused;
-            /* If the snake is not currently moving up, change its direction to down */
-            if (snake->direction != UP) snake->direction = DOWN;
+            input = INPUT_DOWN;
             break;
         case KEY_RIGHT:
-            if (isPaused) isPaused = !isPaused;
-            /* If the snake is not currently moving left, change its direction to right */
-            if (snake->direction != LEFT) snake->direction = RIGHT;
+            input = INPUT_RIGHT;
             break;
         case KEY_LEFT:
-            if (isPaused) isPaused = !isPaused;
-            /* If the snake is not currently moving right, change its direction to left */
-            if (snake->direction != RIGHT) snake->direction = LEFT;
+            input = INPUT_LEFT;
             break;
         case 'p':
-            isPaused = !isPaused;
+            input = INPUT_PAUSE;
             break;
+        case 's':
+            saveGame();
+            return;
         default:
             /* Do nothing for other keys */
-            refresh();
-            break;
+            return;
     }
-}
 
-/* Function responsible of drawing each object in the screen */
-void drawGame() {
-    /* Clear the terminal screen */
-    erase();
-
-    /* Create a ncurses window for the game board */
-    WINDOW *gameBoard = newwin(SCREEN_HEIGHT, SCREEN_WIDTH, startY, startX);
-    box(gameBoard, 0, 0);
-    refresh();
-    wrefresh(gameBoard);
-
-    /* Draw the snake's head on the game board */
-    SnakeNode *snake_ptr = snake->head;
-    switch (snake->direction) {
-        case LEFT:
-            mvaddch(snake_ptr->pY + startY, snake_ptr->pX + startX, SNAKE_HEAD_L);
-            break;
-        case RIGHT:
-            mvaddch(snake_ptr->pY + startY, snake_ptr->pX + startX, SNAKE_HEAD_R);
-            break;
-        case UP:
-            mvaddch(snake_ptr->pY + startY, snake_ptr->pX + startX, SNAKE_HEAD_U);
-            break;
-        case DOWN:
-            mvaddch(snake_ptr->pY + startY, snake_ptr->pX + startX, SNAKE_HEAD_D);
-            break;
+    /* A replay only follows the recording, and the autopilot only lets the player pause */
+    if (replay != NULL || (planner != NULL && input != INPUT_PAUSE)) return;
+
+    /* Turns wait for their tick, unless the game is paused where a turn also resumes it right away */
+    if (input != INPUT_PAUSE && !game->isPaused) {
+        queueTurn(&turns, game, input);
+        return;
     }
 
-    /* Move to the next node */
-    snake_ptr = snake_ptr->next;
+    clearTurns(&turns);
+    applyTurn(input);
+}
 
-    /* Draw the snake's body */
-    while(snake_ptr != NULL) {
-        mvaddch(snake_ptr->pY + startY, snake_ptr->pX + startX, SNAKE_BODY);
-        /* Move to the next node */
-        snake_ptr = snake_ptr->next;
+/* Function responsible of applying an input to the game */
+void applyTurn(Input input) {
+    /* Only inputs that changed the direction or the pause state are worth recording */
+    if (applyInput(game, input) && recorder != NULL) {
+        recordInput(recorder, game, input);
     }
+}
+
+/* Function responsible of saving the game, paused so it is resumed the way it was left */
+void saveGame() {
+    if (savePath == NULL || replay != NULL || !game->isAlive) return;
 
-    /* Draw the apple on the game board */
-    mvaddch(apple->pY + startY, apple->pX + startX, FOOD);
+    clearTurns(&turns);
+    if (!game->isPaused) applyTurn(INPUT_PAUSE);
 
-    /* Display the game score */
-    mvprintw(startY, startX + 1, "Score: %d", snakeSize() - START_SNAKE_SIZE);
+    Snapshot *snapshot = takeSnapshot(game);
+    if (!saveSnapshot(snapshot, savePath)) renderer->alert();
+    freeSnapshot(snapshot);
 }
 
 /* Game loop function */
 void gameLoop() {
-    /* Take arrow key inputs */
-    int c = getch();
-    if (c != ERR) {
+    /* Wait for the next tick deadline, the next frame if there is something left to draw, or a key.
+     * A paused game has no deadlines, it only waits for a key */
+    bool idle = game->isPaused && replay == NULL;
+    long long phase = statsClock();
+    bool keyReady = schedulerSleep(&scheduler, framePending, idle, STDIN_FILENO);
+    statsRecord(PHASE_SLEEP, phase);
+
+    /* Take every key that arrived, the backend is drained so the next sleep does not miss buffered ones */
+    phase = statsClock();
+    int c;
+    while (keyReady && (c = renderer->readKey(false)) != ERR) {
+        if (!keyPending) keyTime = statsClock();
+        keyPending = true;
         handleInput(c);
+        framePending = true;
     }
+    statsRecord(PHASE_INPUT, phase);
+
+    /* Resuming from a pause starts from fresh deadlines instead of catching up on the paused time */
+    if (idle && !game->isPaused) resyncScheduler(&scheduler);
+
+    /* Simulate every tick that is due, at the logical tick rate given by the speed */
+    unsigned int ticks = schedulerTicksDue(&scheduler, game->speed * 800000L);
+    for (; ticks > 0 && game->isAlive; ticks--) {
+        /* A replay applies the recorded inputs right before the tick they were made on */
+        Input input;
+        while (replay != NULL && replayInput(replay, game, &input)) {
+            applyInput(game, input);
+            framePending = true;
+        }
 
-    // Check if the game is not paused before updating the snake position
-    if (!isPaused) {
-        updateSnake();
+        // Check if the game is not paused before updating the snake position
+        if (!game->isPaused) {
+            /* Apply the autopilot's move, or the oldest typed ahead turn, one per tick */
+            Input turn;
+            if (planner != NULL) applyTurn(plannerInput(planner, game));
+            else if (searcher != NULL) applyTurn(searchInput(searcher, game));
+            else if (nextTurn(&turns, &turn)) applyTurn(turn);
+
+            phase = statsClock();
+            bool ateApple = moveSnake(game);
+            statsRecord(PHASE_SNAKE, phase);
+
+            if (ateApple) {
+                phase = statsClock();
+                feedSnake(game);
+                statsRecord(PHASE_APPLE, phase);
+            }
+            if (regions != NULL) syncRegions(regions, game);
+            framePending = true;
+        }
     }
 
-    /* Redraw the frame */
-    drawGame();
+    /* Redraw the frame, at most at the frame rate cap but always once the game is over */
+    if (framePending && (schedulerFrameDue(&scheduler) || !game->isAlive)) {
+        phase = statsClock();
+        if (regions != NULL) {
+            syncRegions(regions, game);
+            warnTrap(!game->isPaused && trapAhead(regions, game));
+        }
+        drawGame(game);
+        statsRecord(PHASE_DRAW, phase);
+
+        phase = statsClock();
+        renderer->present();
+        statsRecord(PHASE_REFRESH, phase);
 
-    /* Refresh the window */
-    refresh();
-    
-    /* Introduce a delay for the game loop */
-    usleep(speed * 800L);
+        /* The last key read is now visible on the screen */
+        if (keyPending) {
+            statsRecord(PHASE_LATENCY, keyTime);
+            keyPending = false;
+        }
+        framePending = false;
+    }
 }
 
 /* Function responsible of initializing the game */
-int initializeGame() {
-    /* Initialize window settings with ncurses */
-    initscr();
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
-    curs_set(0);
-
-    /* Detect if the terminal window is smaller than the board */
-    if (SCREEN_HEIGHT > LINES || SCREEN_WIDTH > COLS) {
-        endwin();
+int initializeGame(uint64_t seed, int width, int height, unsigned int food, bool autopilot, bool traps) {
+    /* Take over the terminal with the chosen backend, bigger boards than the terminal are scrolled */
+    if (!renderer->start(width, height)) {
         fprintf(stderr, "ERROR: The terminal window needs to be larger.\n");
         return 1;
     }
 
-    nodelay(stdscr, TRUE);
+    /* Initialize the tick and frame scheduler */
+    startScheduler(&scheduler, FRAME_RATE_CAP);
 
-    /* Set starting X and Y coordinates to center ncurses windows */
-    getmaxyx(stdscr, terminalRows, terminalCols);
-    startY = (terminalRows - SCREEN_HEIGHT) / 2;
-    startX = (terminalCols - SCREEN_WIDTH) / 2;
-
-    /* Initialize the snake doubly-linked list */
-    snake = startSnake();
-    
-    /* Initialize the apple */
-    apple = startApple();
+    /* Initialize the game state */
+    game = startGame(width, height, seed);
+    if (level != NULL) {
+        setLevel(game, level);
+        resetGame(game);
+    }
+    if (food > 0) {
+        setFood(game, food);
+        startFood(game);
+    }
+    if (resume != NULL) {
+        restoreGame(game, resume);
+        unmapSnapshot(resume);
+        resume = NULL;
+    }
+    if (autopilot) planner = startPlanner(game);
+    if (traps) regions = startRegions(game);
 
     /* Run the game */
     run();
@@ -466,44 +607,65 @@ void run() {
     int choice;
     bool isRunning = true;
 
-    /* Create an ncurses window for the main menu */
-    WINDOW * menuScreen = newwin(SCREEN_HEIGHT, SCREEN_WIDTH, startY, startX);
-    refresh();
-    wrefresh(menuScreen);
+    /* A replay plays its games back to back in real time, without the menu */
+    if (replay != NULL) {
+        playReplay();
+        return;
+    }
 
     while (isRunning) {
         /* Display main menu */
-        mainMenu(menuScreen, 1);
+        mainMenu(1);
 
         /* Input validation loop */
         do {
-            /* Use wgetch to get a single character */
-            choice = wgetch(menuScreen);
+            /* Wait for a single key */
+            choice = renderer->readKey(true);
 
-        } while (choice < '1' || choice > '3');
+        } while (choice < '1' || choice > '4');
 
         switch (choice) {
             case '1':
-                if (!isAlive) {
-                    cleanup();
-                    snake = startSnake();
-                    apple = startApple();
-                    isAlive = true;
-                    speed = minSpeed;
+                if (!game->isAlive) {
+                    resetGame(game);
                 }
-                /* Start the game loop */
-                while (isAlive) {
+                /* Draw the whole board once, then start the game loop from fresh deadlines */
+                clearTurns(&turns);
+                renderer->clearScreen();
+                drawBoard(game);
+                resyncScheduler(&scheduler);
+
+                /* A resumed game starts paused, its first frame can not wait for a tick */
+                framePending = true;
+                struct timespec started, ended;
+                clock_gettime(CLOCK_MONOTONIC, &started);
+                while (game->isAlive) {
                     gameLoop();
                 }
-                score = snakeSize() - START_SNAKE_SIZE;
-                mainMenu(menuScreen, 3);
+                if (recorder != NULL) recordGameOver(recorder);
+                score = gameScore(game);
+                if (scores != NULL) {
+                    ScoreRecord record;
+                    clock_gettime(CLOCK_MONOTONIC, &ended);
+                    makeScore(&record, game, sessionSeed, gamesPlayed, planner != NULL ? PLAYER_AUTOPILOT
+                                                             : searcher != NULL ? PLAYER_SEARCH : PLAYER_HUMAN,
+                              (ended.tv_sec - started.tv_sec) * 1000 + (ended.tv_nsec - started.tv_nsec) / 1000000);
+                    addScore(scores, &record);
+                }
+                gamesPlayed++;
+                mainMenu(3);
                 break;
             case '2':
                 /* Show controls */
-                mainMenu(menuScreen, 2);
+                mainMenu(2);
                 continue;
                 break;
             case '3':
+                /* Show the best games ever recorded */
+                mainMenu(4);
+                continue;
+                break;
+            case '4':
                 /* Exit the game */
                 isRunning = false;
                 break;
@@ -513,65 +675,201 @@ void run() {
     }
 }
 
+/* Function responsible of playing back a recording in real time */
+void playReplay() {
+    for (;;) {
+        /* Draw the whole board once, then run the game loop until the recorded game ends */
+        renderer->clearScreen();
+        drawBoard(game);
+        resyncScheduler(&scheduler);
+        while (game->isAlive && !(game->isPaused && replayFinished(replay))) {
+            gameLoop();
+        }
+
+        /* Move on to the next recorded game, if any */
+        if (game->isAlive || !replayNextGame(replay)) break;
+        resetGame(game);
+    }
+
+    /* Show the final score of the last game */
+    score = gameScore(game);
+    mainMenu(3);
+}
+
+/* Function responsible of playing one snake of an arena against the bots, until it dies */
+int playArena(uint32_t count, uint64_t seed, int width, int height) {
+    if (!renderer->start(width, height)) {
+        fprintf(stderr, "ERROR: The terminal window needs to be larger.\n");
+        return 1;
+    }
+    startScheduler(&scheduler, FRAME_RATE_CAP);
+
+    /* The player is snake 0, the bots are few enough per tick for a single worker */
+    Arena *arena = startArena(count, 1, seed, width, height, 1);
+    bool paused = false;
+    renderer->clearScreen();
+    framePending = true;
+    resyncScheduler(&scheduler);
+
+    while (arena->snakes[0].alive) {
+        bool keyReady = schedulerSleep(&scheduler, framePending, paused, STDIN_FILENO);
+
+        /* Arrows steer on the next tick, the arena only stops for the player while paused */
+        int c;
+        bool wasPaused = paused;
+        while (keyReady && (c = renderer->readKey(false)) != ERR) {
+            switch (c) {
+                case KEY_UP:    steerArena(arena, 0, INPUT_UP); break;
+                case KEY_DOWN:  steerArena(arena, 0, INPUT_DOWN); break;
+                case KEY_LEFT:  steerArena(arena, 0, INPUT_LEFT); break;
+                case KEY_RIGHT: steerArena(arena, 0, INPUT_RIGHT); break;
+                case 'p':       paused = !paused; break;
+                default:        break;
+            }
+            framePending = true;
+        }
+        if (wasPaused && !paused) resyncScheduler(&scheduler);
+
+        unsigned int ticks = schedulerTicksDue(&scheduler, MIN_SPEED * 800000L);
+        for (; !paused && ticks > 0 && arena->snakes[0].alive; ticks--) {
+            stepArena(arena);
+            framePending = true;
+        }
+
+        if (framePending && (schedulerFrameDue(&scheduler) || !arena->snakes[0].alive)) {
+            drawArena(arena, 0);
+            renderer->present();
+            framePending = false;
+        }
+    }
+
+    score = arenaScore(arena, 0);
+    mainMenu(3);
+    freeArena(arena);
+    renderer->stop();
+    return 0;
+}
+
+/* Function responsible of opening the score log of a bot run, which only keeps its games when asked to as they
+ * would bury the ones played by hand. Returns false when the log given can not be written */
+bool openBotScores(const char *path) {
+    if (path == NULL) return true;
+
+    scores = openScores(path);
+    if (scores == NULL) {
+        fprintf(stderr, "ERROR: Could not open the score log '%s'.\n", path);
+        return false;
+    }
+    if (scores->readOnly) {
+        fprintf(stderr, "ERROR: The score log '%s' is in use by another game.\n", path);
+        closeScores(scores);
+        scores = NULL;
+        return false;
+    }
+    return true;
+}
+
 /* Function to display the main menu */
-void mainMenu(WINDOW *menuScreen, int menuType) {
+void mainMenu(int menuType) {
     int menuY = (SCREEN_HEIGHT - 5) / 5;
     int menuX = (SCREEN_WIDTH - 30) / 2;
-
-    wclear(menuScreen);
-    box(menuScreen, 0, 0);
-    mvwprintw(menuScreen, menuY - 1, menuX - 2, "                          ____      ");
-    mvwprintw(menuScreen, menuY,     menuX - 2, " ________________________/ O  \\___/");
-    mvwprintw(menuScreen, menuY + 1, menuX - 2, "<_____________________________/   \\");
-    mvwprintw(menuScreen, menuY + 2, menuX - 2, " __                            _    ");
-    mvwprintw(menuScreen, menuY + 3, menuX - 2, "/ _\\ ___ _ __ _ __   ___ _ __ | |_ ");
-    mvwprintw(menuScreen, menuY + 4, menuX - 2, "\\ \\ / _ \\ '__| '_ \\ / _ \\ '_ \\| __|");
-    mvwprintw(menuScreen, menuY + 5, menuX - 2, "_\\ \\  __/ |  | |_) |  __/ | | | |_ ");
-    mvwprintw(menuScreen, menuY + 6, menuX - 2, "\\__/\\___|_|  | .__/ \\___|_| |_|\\__|");
-    mvwprintw(menuScreen, menuY + 7, menuX - 2, "             |_|                    ");
+    char line[SCREEN_WIDTH];
+
+    /* The board may be bigger than the menu, the backend clears whatever it left around it */
+    renderer->openMenu();
+
+    /* The high scores need the room of the logo */
+    if (menuType != 4) {
+        renderer->menuText(menuY - 1, menuX - 2, "                          ____      ");
+        renderer->menuText(menuY,     menuX - 2, " ________________________/ O  \\___/");
+        renderer->menuText(menuY + 1, menuX - 2, "<_____________________________/   \\");
+        renderer->menuText(menuY + 2, menuX - 2, " __                            _    ");
+        renderer->menuText(menuY + 3, menuX - 2, "/ _\\ ___ _ __ _ __   ___ _ __ | |_ ");
+        renderer->menuText(menuY + 4, menuX - 2, "\\ \\ / _ \\ '__| '_ \\ / _ \\ '_ \\| __|");
+        renderer->menuText(menuY + 5, menuX - 2, "_\\ \\  __/ |  | |_) |  __/ | | | |_ ");
+        renderer->menuText(menuY + 6, menuX - 2, "\\__/\\___|_|  | .__/ \\___|_| |_|\\__|");
+        renderer->menuText(menuY + 7, menuX - 2, "             |_|                    ");
+    }
 
     switch (menuType) {
         case 1:
             /* Print the main menu inside the menuScreen window */
-            mvwprintw(menuScreen, menuY + 9,  menuX, "\tMain Menu");
-            mvwprintw(menuScreen, menuY + 10, menuX, "\t  1. Start Game");
-            mvwprintw(menuScreen, menuY + 11, menuX, "\t  2. Show Controls");
-            mvwprintw(menuScreen, menuY + 12, menuX, "\t  3. Exit Game");
-            mvwprintw(menuScreen, menuY + 13, menuX, "\tPress a key [1-3]...");
-            wrefresh(menuScreen);
+            renderer->menuText(menuY + 9,  menuX, "\tMain Menu");
+            renderer->menuText(menuY + 10, menuX, "\t  1. Start Game");
+            renderer->menuText(menuY + 11, menuX, "\t  2. Show Controls");
+            renderer->menuText(menuY + 12, menuX, "\t  3. High Scores");
+            renderer->menuText(menuY + 13, menuX, "\t  4. Exit Game");
+            renderer->menuText(menuY + 14, menuX, "\tPress a key [1-4]...");
+            renderer->present();
             break;
         case 2:
             /* Display controls */
-            mvwprintw(menuScreen, menuY + 9,  menuX, "\tControls");
-            mvwprintw(menuScreen, menuY + 10, menuX, "\t  Arrow Up:    Move Up");
-            mvwprintw(menuScreen, menuY + 11, menuX, "\t  Arrow Down:  Move Down");
-            mvwprintw(menuScreen, menuY + 12, menuX, "\t  Arrow Left:  Move Left");
-            mvwprintw(menuScreen, menuY + 13, menuX, "\t  Arrow Right: Move Right");
-            mvwprintw(menuScreen, menuY + 13, menuX, "\t  p:           Pause the game");
-            mvwprintw(menuScreen, menuY + 14, menuX, "\tPress a key to go back...");
-            wrefresh(menuScreen);
-            wgetch(menuScreen);
+            renderer->menuText(menuY + 9,  menuX, "\tControls");
+            renderer->menuText(menuY + 10, menuX, "\t  Arrow Up:    Move Up");
+            renderer->menuText(menuY + 11, menuX, "\t  Arrow Down:  Move Down");
+            renderer->menuText(menuY + 12, menuX, "\t  Arrow Left:  Move Left");
+            renderer->menuText(menuY + 13, menuX, "\t  Arrow Right: Move Right");
+            renderer->menuText(menuY + 13, menuX, "\t  p:           Pause the game");
+            renderer->menuText(menuY + 14, menuX, "\tPress a key to go back...");
+            renderer->present();
+            renderer->readKey(true);
             break;
         case 3:
             /* Display the final score on the main menu */
-            mvwprintw(menuScreen, menuY + 12, menuX, "\tGAME OVER");
-            mvwprintw(menuScreen, menuY + 13, menuX, "\tFinal Score: %d", score);
-            mvwprintw(menuScreen, menuY + 14, menuX, "\tPress a key to go back...");
-            wgetch(menuScreen);
+            renderer->menuText(menuY + 12, menuX, game != NULL && game->isWon ? "\tYOU WIN" : "\tGAME OVER");
+            snprintf(line, sizeof(line), "\tFinal Score: %d", score);
+            renderer->menuText(menuY + 13, menuX, line);
+            renderer->menuText(menuY + 14, menuX, "\tPress a key to go back...");
+            renderer->present();
+            renderer->readKey(true);
+            break;
+        case 4:
+            /* Display the best recorded games, straight from the mapped index so the history size does not matter */
+            renderer->menuText(1, 4, "High Scores");
+            if (scores == NULL || scores->index->topCount == 0) {
+                renderer->menuText(3, 4, scores == NULL ? "No score log is open" : "No games yet");
+            }
+            for (uint32_t i = 0; scores != NULL && i < scores->index->topCount && i < MENU_SCORES; i++) {
+                static const char *players[PLAYER_KINDS] = { "human", "autopilot", "bot", "search" };
+                const ScoreRecord *record = &scores->index->top[i];
+                snprintf(line, sizeof(line), "%2u. %6d  %-9s  seed %llu", i + 1, record->score,
+                         record->player < PLAYER_KINDS ? players[record->player] : "?",
+                         (unsigned long long)record->seed);
+                renderer->menuText(3 + i, 4, line);
+            }
+            snprintf(line, sizeof(line), "%llu games recorded",
+                     scores != NULL ? (unsigned long long)scores->index->records : 0ULL);
+            renderer->menuText(4 + MENU_SCORES, 4, line);
+            renderer->menuText(6 + MENU_SCORES, 4, "Press a key to go back...");
+            renderer->present();
+            renderer->readKey(true);
             break;
     }
 }
 
 /* Function responsible of cleaning the memory */
 void cleanup() {
-    /* Free memory allocated by snake */
-    freeSnake();
-
-    /* Free memory allocated by apple */
-    free(apple);
-
-    /* End ncurses window */
-    endwin();
+    /* Free memory allocated by the game and the autopilot */
+    if (planner != NULL) freePlanner(planner);
+    if (regions != NULL) freeRegions(regions);
+    freeGame(game);
+    if (level != NULL) unmapLevel(level);
+
+    /* Write out the games recorded this session */
+    if (scores != NULL) closeScores(scores);
+
+    /* Close the recording being written or played */
+    if (recorder != NULL) stopRecording(recorder);
+    if (replay != NULL) closeReplay(replay);
+
+    /* Give the terminal back */
+    renderer->stop();
+
+    /* Report how much the search could do in its budget */
+    if (searcher != NULL) {
+        reportSearch(searcher, stderr);
+        freeSearcher(searcher);
+    }
 }
 
 /* Function for displaying the game controls in the command line */
@@ -583,6 +881,7 @@ void argControls() {
     printf("\tArrow Left:  Move Left\n ");
     printf("\tArrow Right: Move Right\n");
     printf("\tp:           Pause the game\n");
+    printf("\ts:           Save the game (with --save)\n");
 }
 
 /* Function to display the help message in the command line */
@@ -590,9 +889,38 @@ void argHelp() {
     printf("Usage: %s [OPTIONS]\n", NAME);
     printf("Play the all time classic snake game in the console.\n\n");
     printf("Options:\n");
+    printf("\t-a, --autopilot      Let the pathfinding planner play, also with --headless.\n");
+    printf("\t    --arena N        Play against N - 1 bots on one board, or with --headless time N bots.\n");
+    printf("\t    --budget P       Share of each tick, in percent, spent by --search (default %d).\n", SEARCH_BUDGET);
+    printf("\t-b, --batch N        Play N games with the bot over a pool of workers and print statistics.\n");
+    printf("\t    --compile-level SOURCE\n");
+    printf("\t                     Compile a text level into the file given with --level and exit.\n");
     printf("\t-c, --show-controls  Show the controls for the game.\n");
+    printf("\t    --food N         Keep N extra food items on the board, some expire and some grow the snake more.\n");
     printf("\t-h, --help           Display this help message and exit.\n");
+    printf("\t    --headless       Run the simulation without a terminal and print ticks/sec.\n");
+    printf("\t    --height H       Board height, borders included (default %d, up to %d).\n", SCREEN_HEIGHT, MAX_BOARD_SIZE);
+    printf("\t-j, --jitter         Print the measured tick jitter on exit.\n");
+    printf("\t    --level FILE     Play on a compiled level instead of the empty box.\n");
+    printf("\t-r, --record FILE    Record the inputs of the session to FILE.\n");
+    printf("\t    --render NAME    Terminal backend: curses (default) or ansi, raw escape sequences.\n");
+    printf("\t-R, --replay FILE    Play back a recording, in real time or with --headless as fast as possible.\n");
+    printf("\t    --resume FILE    Continue the game saved in FILE.\n");
+    printf("\t    --rollout NAME   Moves of the --search rollouts: greedy (default) or random.\n");
+    printf("\t    --save FILE      Save the game to FILE with the 's' key, it pauses the game.\n");
+    printf("\t    --scores FILE    Score log, games played by hand go to ~/%s unless given, bot runs only with it.\n",
+           SCORES_FILE);
+    printf("\t    --search         Let a parallel Monte Carlo tree search play, also with --headless.\n");
+    printf("\t-s, --seed S         Seed for the apple placement.\n");
+    printf("\t    --serve SOCKET   Serve a game to every client of the Unix socket SOCKET.\n");
+    printf("\t-S, --stats          Print the time spent in each phase of the game loop on exit.\n");
+    printf("\t-t, --ticks N        Ticks simulated by --headless (default %d, %d with --arena, %d with --search).\n",
+           HEADLESS_TICKS, ARENA_TICKS, SEARCH_TICKS);
+    printf("\t    --trace FILE     Write every timed phase to FILE as a Chrome trace.\n");
+    printf("\t    --traps          Warn when the snake heads into a region too small to hold it.\n");
     printf("\t-v, --version        Display version and exit.\n");
+    printf("\t-w, --workers N      Worker threads used by --batch, --arena and --search (default: one per core).\n");
+    printf("\t    --width W        Board width, borders included (default %d, up to %d).\n", SCREEN_WIDTH, MAX_BOARD_SIZE);
 }
 
 /* Function to display the version in the command line */
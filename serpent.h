@@ -1,69 +1,33 @@
 #ifndef SERPENT_H
 #define SERPENT_H
 #include <ncurses.h>
+#include "game.h"
+#include "render.h"
 
 /* Program information */
 #define NAME    "serpent"
 #define VERSION 0.1
 /* */
 
-/* Absolute value macro */
-#define ABS(x) (x) < 0 ? -(x) : (x)
+/* Menu constants */
+#define MENU_SCORES 10              /* best games listed on the high scores screen */
 /* */
 
-/* Global variables/constants */
-#define START_SNAKE_SIZE 5          /* snake's initial size */
-#define SNAKE_BODY       '*'        /* snake's body */
-#define SNAKE_HEAD_U     'v'        /* head when going up */
-#define SNAKE_HEAD_D     '^'        /* head when going down */
-#define SNAKE_HEAD_L     '>'        /* head when going left */
-#define SNAKE_HEAD_R     '<'        /* head when going right  */
-#define FOOD             '@'        /* normal food */
-#define SCREEN_WIDTH     50         /* the virtual screen width */
-#define SCREEN_HEIGHT    20	        /* the virtual screen height */
+/* Absolute value macro */
+#define ABS(x) (x) < 0 ? -(x) : (x)
 /* */
 
-/* Possible directions for the snake */
-typedef enum {
-    UP,
-    DOWN,
-    LEFT,
-    RIGHT
-} Direction;
-
-/* Snake node structure (for dobly linked list) */
-typedef struct SnakeNode {
-    int pX, pY;                     /* represents the node's position on the board */
-    struct SnakeNode *next, *prev; /* pointers to the next and previous nodes */
-} SnakeNode;
-
-/* Snake structure (dobly linked list) */
-typedef struct Snake {
-    Direction direction;
-    SnakeNode *head, *tail;    /* snake's nodes, dobly linked list */
-} Snake;
-
-/* Apple structure */
-typedef struct Food {
-    int pX, pY;    /* represents the apple's position on the board */
-} Apple;
-
 /* Function prototypes */
-Snake *startSnake();
-Apple *startApple();
-void appendSnakeNode(Snake *new_snake);
-void freeSnake();
-int snakeSize();
-void updateSnake();
-void updateApple();
-bool snakeCollision(int x, int y, bool excludeHead);
-bool appleCollision(int x, int y);
 void handleInput(int key);
-void drawGame();
-int initializeGame();
+void applyTurn(Input input);
+void saveGame();
+int initializeGame(uint64_t seed, int width, int height, unsigned int food, bool autopilot, bool traps);
 void gameLoop();
 void run();
-void mainMenu(WINDOW *menuScreen, int menuType);
+void playReplay();
+int playArena(uint32_t count, uint64_t seed, int width, int height);
+bool openBotScores(const char *path);
+void mainMenu(int menuType);
 void cleanup();
 void argControls();
 void argHelp();
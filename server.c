@@ -0,0 +1,450 @@
+/* 
+ * server.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "game.h"
+#include "input.h"
+#include "server.h"
+/* */
+
+/* Set by SIGINT and SIGTERM to stop the event loop */
+static volatile sig_atomic_t stopping = 0;
+/* */
+
+/* Function prototypes for the internal helpers */
+static void stopServer(int signal);
+static uint64_t monotonicTime();
+static int openListener(const char *path);
+static void acceptClients(Server *server);
+static void startSession(Server *server, int fd);
+static void closeSession(Server *server, Session *session);
+static void freeClosed(Server *server);
+static void readSession(Server *server, Session *session);
+static void runWheel(Server *server);
+static void stepSession(Server *server, Session *session);
+static void scheduleSession(Server *server, Session *session);
+static void unscheduleSession(Server *server, Session *session);
+static void armTimer(Server *server, bool armed);
+static bool sendGame(Session *session);
+static bool queueOutput(Session *session, const uint8_t *bytes, unsigned int count);
+static bool flushSession(Server *server, Session *session);
+static unsigned int putWord(uint8_t *bytes, int value);
+/* */
+
+/* Function responsible of serving a game to every client of a Unix socket until interrupted.
+ * One single-threaded epoll loop multiplexes the clients, their ticks come from one timer wheel */
+int runServer(const char *path, uint64_t seed, int width, int height, FILE *out) {
+    Server server;
+    memset(&server, 0, sizeof(Server));
+    server.seed = seed;
+    server.width = width;
+    server.height = height;
+
+    /* Every session takes a descriptor, allow as many as the system lets us */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    server.listener = openListener(path);
+    if (server.listener < 0) return 1;
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    server.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    /* The listener and the timer are told apart from the sessions by their pointers */
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event);
+    event.data.ptr = &server;
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.timer, &event);
+
+    /* Stop cleanly on Ctrl-C, without SA_RESTART so epoll_wait returns */
+    struct sigaction action = { .sa_handler = stopServer };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(out, "Serving %dx%d games on %s\n", width, height, path);
+    fflush(out);
+
+    uint64_t start = monotonicTime();
+    static struct epoll_event events[SERVER_EVENTS];
+    while (!stopping) {
+        int count = epoll_wait(server.epoll, events, SERVER_EVENTS, -1);
+        if (count < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < count; i++) {
+            void *source = events[i].data.ptr;
+            if (source == NULL) {
+                acceptClients(&server);
+            } else if (source == &server) {
+                uint64_t expirations;
+                if (read(server.timer, &expirations, sizeof(expirations)) > 0) runWheel(&server);
+            } else {
+                /* A session closed earlier in the batch may still have events in it */
+                Session *session = source;
+                if (session->fd < 0) continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    closeSession(&server, session);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !flushSession(&server, session)) continue;
+                if (events[i].events & EPOLLIN) readSession(&server, session);
+            }
+        }
+        freeClosed(&server);
+    }
+    double elapsed = (monotonicTime() - start) / 1e9;
+
+    /* Close every session still in the wheel */
+    for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+        while (server.wheel[slot] != NULL) closeSession(&server, server.wheel[slot]);
+    }
+    freeClosed(&server);
+    close(server.timer);
+    close(server.epoll);
+    close(server.listener);
+    unlink(path);
+
+    fprintf(out, "Served %lu sessions (peak %lu, dropped %lu), %llu ticks in %.1f s: %.0f ticks/sec\n",
+            server.servedSessions, server.peakSessions, server.droppedSessions, server.ticks, elapsed,
+            elapsed > 0 ? server.ticks / elapsed : 0);
+    return 0;
+}
+
+/* Function responsible of the signal handler that ends the event loop */
+static void stopServer(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+/* Function returning a monotonic timestamp in nanoseconds */
+static uint64_t monotonicTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Function responsible of creating the listening socket, replacing a stale one left at the same path */
+static int openListener(const char *path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: The socket path '%s' is too long.\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "ERROR: Could not listen on '%s': %s.\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Function responsible of taking every pending connection */
+static void acceptClients(Server *server) {
+    int fd;
+    while ((fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        startSession(server, fd);
+    }
+}
+
+/* Function responsible of starting a session with a new game, its first tick is one period away */
+static void startSession(Server *server, int fd) {
+    Session *session = malloc(sizeof(Session));
+    session->fd = fd;
+    session->game = startGame(server->width, server->height, server->seed);
+    seedGame(session->game, server->seed, server->nextGame++);
+    resetGame(session->game);
+    clearDirty(session->game);
+    clearTurns(&session->turns);
+    session->outputStart = session->outputEnd = 0;
+    session->waitingOutput = false;
+    session->slot = -1;
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = session };
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+
+    /* The wheel starts turning with its first session */
+    if (server->sessions++ == 0) armTimer(server, true);
+    if (server->sessions > server->peakSessions) server->peakSessions = server->sessions;
+    server->servedSessions++;
+
+    session->deadline = monotonicTime() + session->game->speed * 800000ULL;
+    scheduleSession(server, session);
+
+    sendGame(session);
+    flushSession(server, session);
+}
+
+/* Function responsible of ending a session. Later events of the same batch may still point at it,
+ * so it is only marked closed here and freed by freeClosed once the batch is over */
+static void closeSession(Server *server, Session *session) {
+    if (session->fd < 0) return;
+
+    unscheduleSession(server, session);
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    session->fd = -1;
+    session->next = server->closed;
+    server->closed = session;
+
+    if (--server->sessions == 0) armTimer(server, false);
+}
+
+/* Function responsible of freeing the sessions closed since the last call */
+static void freeClosed(Server *server) {
+    while (server->closed != NULL) {
+        Session *session = server->closed;
+        server->closed = session->next;
+        freeGame(session->game);
+        free(session);
+    }
+}
+
+/* Function responsible of reading the inputs of a client, handled like keys in the terminal */
+static void readSession(Server *server, Session *session) {
+    uint8_t bytes[64];
+    ssize_t count;
+
+    while ((count = read(session->fd, bytes, sizeof(bytes))) > 0) {
+        for (ssize_t i = 0; i < count; i++) {
+            Input input = bytes[i];
+            if (input < INPUT_UP || input > INPUT_PAUSE) continue;
+
+            /* Turns wait for their tick, unless the game is paused where a turn also resumes it right away */
+            if (input != INPUT_PAUSE && !session->game->isPaused) {
+                queueTurn(&session->turns, session->game, input);
+            } else {
+                clearTurns(&session->turns);
+                applyInput(session->game, input);
+            }
+        }
+    }
+
+    /* The client went away */
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        closeSession(server, session);
+    }
+}
+
+/* Function responsible of running every slot of the wheel that is due */
+static void runWheel(Server *server) {
+    uint64_t now = monotonicTime() / 1000000;
+
+    for (; server->wheelTime <= now; server->wheelTime++) {
+        /* Take the whole slot first, the sessions that ticked go back into later slots */
+        Session *session = server->wheel[server->wheelTime % WHEEL_SLOTS];
+        server->wheel[server->wheelTime % WHEEL_SLOTS] = NULL;
+
+        while (session != NULL) {
+            Session *next = session->next;
+            session->slot = -1;
+            session->prev = session->next = NULL;
+            stepSession(server, session);
+            session = next;
+        }
+    }
+}
+
+/* Function responsible of one tick of a session and of sending its delta */
+static void stepSession(Server *server, Session *session) {
+    GameState *game = session->game;
+    session->deadline += game->speed * 800000ULL;
+
+    /* A paused game keeps its place in the wheel but does not move */
+    if (game->isPaused) {
+        scheduleSession(server, session);
+        return;
+    }
+
+    unsigned int length = game->snake.length;
+    Apple apple = game->apple;
+    Input turn;
+    if (nextTurn(&session->turns, &turn)) applyInput(game, turn);
+    updateSnake(game);
+    clearDirty(game);
+    server->ticks++;
+
+    /* The head always moves, the tail only when the length stayed the same */
+    uint8_t delta[5];
+    unsigned int size = 1;
+    delta[0] = game->snake.direction;
+    if (game->snake.length == length) delta[0] |= DELTA_TAIL;
+    if (game->apple.pX != apple.pX || game->apple.pY != apple.pY) {
+        delta[0] |= DELTA_APPLE;
+        size += putWord(&delta[size], game->apple.pX);
+        size += putWord(&delta[size], game->apple.pY);
+    }
+    if (!game->isAlive) delta[0] |= DELTA_DEAD;
+    if (game->isWon) delta[0] |= DELTA_WON;
+    bool queued = queueOutput(session, delta, size);
+
+    /* The session goes on with the next game right away */
+    if (!game->isAlive) {
+        seedGame(game, server->seed, server->nextGame++);
+        resetGame(game);
+        clearDirty(game);
+        clearTurns(&session->turns);
+        session->deadline = monotonicTime() + game->speed * 800000ULL;
+        queued = queued && sendGame(session);
+    }
+
+    /* A client too slow to read its deltas is dropped, its memory stays bounded */
+    if (!queued) {
+        server->droppedSessions++;
+        closeSession(server, session);
+        return;
+    }
+
+    scheduleSession(server, session);
+    flushSession(server, session);
+}
+
+/* Function responsible of putting a session in the wheel slot of its deadline, never in one already run */
+static void scheduleSession(Server *server, Session *session) {
+    uint64_t due = session->deadline / 1000000;
+    if (due < server->wheelTime + 1) due = server->wheelTime + 1;
+
+    session->slot = due % WHEEL_SLOTS;
+    Session **slot = &server->wheel[session->slot];
+    session->prev = NULL;
+    session->next = *slot;
+    if (*slot != NULL) (*slot)->prev = session;
+    *slot = session;
+}
+
+/* Function responsible of taking a session out of the wheel */
+static void unscheduleSession(Server *server, Session *session) {
+    if (session->slot < 0) return;
+
+    if (session->prev != NULL) session->prev->next = session->next;
+    else server->wheel[session->slot] = session->next;
+    if (session->next != NULL) session->next->prev = session->prev;
+    session->slot = -1;
+    session->prev = session->next = NULL;
+}
+
+/* Function responsible of starting or stopping the millisecond timer that turns the wheel */
+static void armTimer(Server *server, bool armed) {
+    struct itimerspec period = { { 0, 0 }, { 0, 0 } };
+    if (armed) {
+        period.it_interval.tv_nsec = 1000000;
+        period.it_value.tv_nsec = 1000000;
+        server->wheelTime = monotonicTime() / 1000000;
+    }
+    timerfd_settime(server->timer, 0, &period, NULL);
+}
+
+/* Function responsible of queueing the game message that starts every game */
+static bool sendGame(Session *session) {
+    const GameState *game = session->game;
+    uint8_t message[SERVER_OUTPUT];
+    unsigned int size = 0;
+
+    /* Games always start short, a game message that does not fit is a board the server can not host */
+    if (12 + 4 * game->snake.length > SERVER_OUTPUT) return false;
+
+    message[size++] = MESSAGE_GAME;
+    size += putWord(&message[size], game->board.width);
+    size += putWord(&message[size], game->board.height);
+    size += putWord(&message[size], game->snake.length);
+    for (unsigned int i = 0; i < game->snake.length; i++) {
+        Position *segment = snakeSegment(game, i);
+        size += putWord(&message[size], segment->pX);
+        size += putWord(&message[size], segment->pY);
+    }
+    size += putWord(&message[size], game->apple.pX);
+    size += putWord(&message[size], game->apple.pY);
+    message[size++] = game->snake.direction;
+
+    return queueOutput(session, message, size);
+}
+
+/* Function responsible of appending bytes to a session's output, returns false when they do not fit */
+static bool queueOutput(Session *session, const uint8_t *bytes, unsigned int count) {
+    if (session->outputEnd + count > SERVER_OUTPUT) {
+        /* Slide what is left to the front before giving up */
+        unsigned int pending = session->outputEnd - session->outputStart;
+        memmove(session->output, session->output + session->outputStart, pending);
+        session->outputStart = 0;
+        session->outputEnd = pending;
+        if (pending + count > SERVER_OUTPUT) return false;
+    }
+
+    memcpy(session->output + session->outputEnd, bytes, count);
+    session->outputEnd += count;
+    return true;
+}
+
+/* Function responsible of writing a session's output, watching the socket for room when it is full.
+ * Returns false when the session was closed */
+static bool flushSession(Server *server, Session *session) {
+    while (session->outputStart < session->outputEnd) {
+        ssize_t written = send(session->fd, session->output + session->outputStart,
+                               session->outputEnd - session->outputStart, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closeSession(server, session);
+                return false;
+            }
+            break;
+        }
+        session->outputStart += written;
+    }
+
+    /* Only watch for room while there is something left to write */
+    bool pending = session->outputStart < session->outputEnd;
+    if (!pending) session->outputStart = session->outputEnd = 0;
+    if (pending != session->waitingOutput) {
+        struct epoll_event event = { .events = EPOLLIN | (pending ? EPOLLOUT : 0), .data.ptr = session };
+        epoll_ctl(server->epoll, EPOLL_CTL_MOD, session->fd, &event);
+        session->waitingOutput = pending;
+    }
+    return true;
+}
+
+/* Function responsible of writing a little-endian 16-bit word, -1 turns into 0xFFFF */
+static unsigned int putWord(uint8_t *bytes, int value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    return 2;
+}
@@ -0,0 +1,59 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "game.h"
+#include "input.h"
+
+/* Server constants */
+#define SERVER_EVENTS    256        /* events taken from epoll per wake-up */
+#define SERVER_OUTPUT    1024       /* bytes queued per session before a client that does not read is dropped */
+#define WHEEL_SLOTS      128        /* one millisecond slots, more than the longest tick */
+/* */
+
+/* Messages sent to the clients. Every game starts with a game message, then each tick sends one delta byte.
+ * Game:     0xFF, width and height (u16), length (u16), length segments head first (x, y as u16),
+ *           apple (x, y as u16, 0xFFFF when there is none), direction (u8). All numbers little-endian.
+ * Delta:    direction in bits 0-1, DELTA_TAIL when the tail moved, DELTA_APPLE followed by the new apple (x, y as
+ *           u16), DELTA_DEAD when the game is over and DELTA_WON when the board was filled. The head moves one cell
+ *           in the direction. A new game message follows the delta that ended a game.
+ * Clients send one Input value per byte, turns are queued like the keyboard's and other bytes are ignored. */
+#define DELTA_TAIL       0x04
+#define DELTA_APPLE      0x08
+#define DELTA_DEAD       0x10
+#define DELTA_WON        0x20
+#define MESSAGE_GAME     0xFF
+/* */
+
+/* Session structure, one client with its own game and tick deadline */
+typedef struct Session {
+    int fd;                         /* -1 once the session is closed and waits to be freed */
+    GameState *game;
+    TurnQueue turns;
+    uint64_t deadline;              /* next tick, in nanoseconds on the monotonic clock */
+    int slot;                       /* timer wheel slot holding the session, -1 while it is out of the wheel */
+    struct Session *prev, *next;    /* neighbours in that slot, next also links the closed sessions */
+    uint8_t output[SERVER_OUTPUT];  /* bytes not taken by the socket yet */
+    unsigned int outputStart, outputEnd;
+    bool waitingOutput;             /* the socket is watched for room to write */
+} Session;
+
+/* Server structure, every session of one event loop */
+typedef struct Server {
+    int epoll, listener, timer;
+    Session *wheel[WHEEL_SLOTS];    /* sessions by the millisecond of their next tick */
+    Session *closed;                /* sessions closed during a batch of events, freed after it */
+    uint64_t wheelTime;             /* next millisecond of the wheel to run */
+    uint64_t seed;
+    unsigned long nextGame;         /* random stream of the next game handed out */
+    int width, height;
+    unsigned long sessions, peakSessions, servedSessions, droppedSessions;
+    unsigned long long ticks;
+} Server;
+
+/* Function prototypes */
+int runServer(const char *path, uint64_t seed, int width, int height, FILE *out);
+/* */
+
+#endif //SERVER_H
@@ -0,0 +1,323 @@
+/* 
+ * snapshot.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.h"
+#include "level.h"
+#include "snapshot.h"
+/* */
+
+/* Function prototypes for the internal helpers */
+static size_t alignUp(size_t bytes);
+static void layoutSnapshot(Snapshot *snapshot, int width, int height, unsigned int length, unsigned int food);
+/* */
+
+/* Function returning the bytes taken by the snapshot of a board, a snake of the given length and food items */
+size_t snapshotSize(int width, int height, unsigned int length, unsigned int food) {
+    Snapshot layout;
+    layoutSnapshot(&layout, width, height, length, food);
+    return layout.size;
+}
+
+/* Function responsible of taking a snapshot of a game into a new block of memory */
+Snapshot *takeSnapshot(const GameState *state) {
+    Snapshot *snapshot = malloc(snapshotSize(state->board.width, state->board.height, state->snake.length,
+                                             state->food.count));
+    captureGame(state, snapshot);
+    return snapshot;
+}
+
+/* Function responsible of writing a snapshot of a game, the memory must hold snapshotSize() bytes */
+void captureGame(const GameState *state, Snapshot *snapshot) {
+    const Board *board = &state->board;
+    const Snake *snake = &state->snake;
+    uint8_t *base = (uint8_t *)snapshot;
+
+    layoutSnapshot(snapshot, board->width, board->height, snake->length, state->food.count);
+    snapshot->direction = snake->direction;
+    snapshot->growth = snake->growth;
+    snapshot->speed = state->speed;
+    snapshot->appleX = state->apple.pX;
+    snapshot->appleY = state->apple.pY;
+    snapshot->isAlive = state->isAlive;
+    snapshot->isWon = state->isWon;
+    snapshot->isPaused = state->isPaused;
+    snapshot->wrap = (board->wrapX ? LEVEL_WRAP_X : 0) | (board->wrapY ? LEVEL_WRAP_Y : 0);
+    snapshot->freeCount = board->freeCount;
+    snapshot->ticks = state->ticks;
+    snapshot->foodTarget = state->food.target;
+    memcpy(snapshot->rng, state->rng.s, sizeof(snapshot->rng));
+
+    /* Unroll the ring buffer so the body starts with the head, it takes at most two copies */
+    Position *body = (Position *)(base + snapshot->bodyOffset);
+    unsigned int first = snake->capacity - snake->head;
+    if (first > snake->length) first = snake->length;
+    memcpy(body, &snake->body[snake->head], first * sizeof(Position));
+    memcpy(body + first, snake->body, (snake->length - first) * sizeof(Position));
+
+    /* The grid is copied as is, so restoring it does not have to replay the body */
+    size_t words = ((size_t)board->width * board->height + 63) / 64;
+    size_t blocks = (words + BOARD_BLOCK_WORDS - 1) / BOARD_BLOCK_WORDS;
+    memcpy(base + snapshot->occupiedOffset, board->occupied, words * sizeof(uint64_t));
+    memcpy(base + snapshot->wallsOffset, board->walls, words * sizeof(uint64_t));
+    memcpy(base + snapshot->blockFreeOffset, board->blockFree, blocks * sizeof(uint16_t));
+
+    /* Food items are found through the table, the pool also holds unused ones */
+    SnapshotFood *food = (SnapshotFood *)(base + snapshot->foodOffset);
+    for (uint32_t slot = 0; state->food.count > 0 && slot <= state->food.tableMask; slot++) {
+        if (state->food.table[slot] == 0) continue;
+        const FoodItem *item = &state->food.items[state->food.table[slot] - 1];
+        *food++ = (SnapshotFood){ item->pX, item->pY, item->kind, item->expires };
+    }
+}
+
+/* Function responsible of forking a snapshot, a single copy as nothing inside points anywhere */
+Snapshot *forkSnapshot(const Snapshot *snapshot) {
+    Snapshot *fork = malloc(snapshot->size);
+    memcpy(fork, snapshot, snapshot->size);
+    return fork;
+}
+
+/* Function responsible of turning a game into the one in the snapshot, both boards must have the same size */
+void restoreGame(GameState *state, const Snapshot *snapshot) {
+    Board *board = &state->board;
+    Snake *snake = &state->snake;
+    const uint8_t *base = (const uint8_t *)snapshot;
+
+    snake->direction = snapshot->direction;
+    snake->length = snapshot->length;
+    snake->growth = snapshot->growth;
+    snake->head = 0;
+    state->speed = snapshot->speed;
+    state->apple.pX = snapshot->appleX;
+    state->apple.pY = snapshot->appleY;
+    state->isAlive = snapshot->isAlive;
+    state->isWon = snapshot->isWon;
+    state->isPaused = snapshot->isPaused;
+    state->ticks = snapshot->ticks;
+    board->freeCount = snapshot->freeCount;
+    board->wrapX = snapshot->wrap & LEVEL_WRAP_X;
+    board->wrapY = snapshot->wrap & LEVEL_WRAP_Y;
+    memcpy(state->rng.s, snapshot->rng, sizeof(state->rng.s));
+
+    size_t words = ((size_t)board->width * board->height + 63) / 64;
+    size_t blocks = (words + BOARD_BLOCK_WORDS - 1) / BOARD_BLOCK_WORDS;
+    memcpy(snake->body, base + snapshot->bodyOffset, snapshot->length * sizeof(Position));
+    memcpy(board->occupied, base + snapshot->occupiedOffset, words * sizeof(uint64_t));
+    memcpy(board->walls, base + snapshot->wallsOffset, words * sizeof(uint64_t));
+    memcpy(board->blockFree, base + snapshot->blockFreeOffset, blocks * sizeof(uint16_t));
+
+    /* Food items go back through the table, the pool is only resized when the game kept another number of them */
+    if (state->food.target != snapshot->foodTarget) setFood(state, snapshot->foodTarget);
+    else emptyFood(state);
+    const SnapshotFood *food = (const SnapshotFood *)(base + snapshot->foodOffset);
+    for (uint32_t i = 0; i < snapshot->foodCount; i++) {
+        addFood(state, food[i].pX, food[i].pY, food[i].kind, food[i].expires);
+    }
+
+    /* Whatever was on the screen belongs to another game */
+    clearDirty(state);
+    state->dirtyOverflow = true;
+}
+
+/* Function responsible of starting a new game from a snapshot */
+GameState *startFromSnapshot(const Snapshot *snapshot) {
+    GameState *state = startGame(snapshot->width, snapshot->height, 0);
+    restoreGame(state, snapshot);
+    return state;
+}
+
+/* Function responsible of checking a snapshot that came from outside before anything trusts it */
+bool checkSnapshot(const Snapshot *snapshot, size_t size) {
+    if (size < sizeof(Snapshot) || memcmp(snapshot->magic, SNAPSHOT_MAGIC, 4) != 0) return false;
+    if (snapshot->version != SNAPSHOT_VERSION || snapshot->size != size) return false;
+
+    /* Refuse boards the engine can not play */
+    int width = snapshot->width, height = snapshot->height;
+    if (width < MIN_BOARD_SIZE || width > MAX_BOARD_SIZE || height < MIN_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+        return false;
+    }
+    if (snapshot->length == 0 || snapshot->length > (uint32_t)width * height || snapshot->direction > RIGHT) {
+        return false;
+    }
+    if (snapshot->foodCount > snapshot->foodTarget || snapshot->foodTarget > (uint32_t)width * height) return false;
+    if (snapshot->wrap > (LEVEL_WRAP_X | LEVEL_WRAP_Y)) return false;
+
+    /* The speed is the tick period, it only goes down to one step past MAX_SPEED (see feedSnake) */
+    if (snapshot->speed < MAX_SPEED - 1 || snapshot->speed > MIN_SPEED) return false;
+    if (snapshot->growth > (uint32_t)width * height) return false;
+
+    /* The offsets must be the ones this version lays out, which also keeps every array inside the snapshot */
+    Snapshot layout;
+    layoutSnapshot(&layout, width, height, snapshot->length, snapshot->foodCount);
+    if (layout.size != snapshot->size || layout.bodyOffset != snapshot->bodyOffset ||
+        layout.occupiedOffset != snapshot->occupiedOffset || layout.wallsOffset != snapshot->wallsOffset ||
+        layout.blockFreeOffset != snapshot->blockFreeOffset || layout.foodOffset != snapshot->foodOffset) {
+        return false;
+    }
+
+    /* Every segment and the apple have to be on the board, the engine indexes the grid with them */
+    const uint8_t *base = (const uint8_t *)snapshot;
+    const Position *body = (const Position *)(base + snapshot->bodyOffset);
+    for (uint32_t i = 0; i < snapshot->length; i++) {
+        if (body[i].pX < 0 || body[i].pX >= width || body[i].pY < 0 || body[i].pY >= height) return false;
+    }
+    bool noApple = snapshot->appleX == -1 && snapshot->appleY == -1;
+    if (!noApple && (snapshot->appleX < 0 || snapshot->appleX >= width || snapshot->appleY < 0 ||
+                     snapshot->appleY >= height)) {
+        return false;
+    }
+
+    /* The apple placement walks the free counts, they have to agree with the grid. The padding bits past the last
+     * cell are occupied like in startGame, a free one would hand out a cell off the board, and so are the walls */
+    const uint64_t *occupied = (const uint64_t *)(base + snapshot->occupiedOffset);
+    const uint64_t *walls = (const uint64_t *)(base + snapshot->wallsOffset);
+    const uint16_t *blockFree = (const uint16_t *)(base + snapshot->blockFreeOffset);
+    size_t cells = (size_t)width * height;
+    size_t words = (cells + 63) / 64;
+    if (cells % 64 && (~occupied[words - 1] & ~(uint64_t)0 << (cells % 64)) != 0) return false;
+    for (size_t word = 0; word < words; word++) {
+        if (walls[word] & ~occupied[word]) return false;
+    }
+    uint64_t freeCount = 0;
+    for (size_t block = 0; block * BOARD_BLOCK_WORDS < words; block++) {
+        unsigned int blockCount = 0;
+        for (size_t word = block * BOARD_BLOCK_WORDS; word < words && word < (block + 1) * BOARD_BLOCK_WORDS; word++) {
+            blockCount += 64 - __builtin_popcountll(occupied[word]);
+        }
+        if (blockCount != blockFree[block]) return false;
+        freeCount += blockCount;
+    }
+
+    if (freeCount != snapshot->freeCount) return false;
+
+    /* The body takes its cells, moving the tail frees them */
+    for (uint32_t i = 0; i < snapshot->length; i++) {
+        if (!boardTest(occupied, (unsigned int)body[i].pY * width + body[i].pX)) return false;
+    }
+
+    /* A head that leaves through a side that does not wrap has to land on a wall, and not off the grid */
+    if (!bordersClosed((const uint64_t *)(base + snapshot->wallsOffset), width, height, snapshot->wrap)) return false;
+
+    /* Food items sit on free cells, each on its own, and timed ones expire within a turn of the wheel */
+    const SnapshotFood *food = (const SnapshotFood *)(base + snapshot->foodOffset);
+    uint64_t *taken = calloc(words, sizeof(uint64_t));
+    bool valid = true;
+    for (uint32_t i = 0; valid && i < snapshot->foodCount; i++) {
+        valid = food[i].pX >= 0 && food[i].pX < width && food[i].pY >= 0 && food[i].pY < height &&
+                food[i].kind <= FOOD_BONUS && (food[i].kind == FOOD_NORMAL) == (food[i].expires == 0) &&
+                (food[i].expires == 0 || (food[i].expires > snapshot->ticks &&
+                                          food[i].expires - snapshot->ticks <= FOOD_TIMED_TICKS));
+        if (!valid) break;
+
+        size_t cell = (size_t)food[i].pY * width + food[i].pX;
+        uint64_t bit = (uint64_t)1 << (cell % 64);
+        valid = !((occupied[cell / 64] | taken[cell / 64]) & bit);
+        taken[cell / 64] |= bit;
+    }
+    free(taken);
+    return valid;
+}
+
+/* Function responsible of writing a snapshot to a file */
+bool saveSnapshot(const Snapshot *snapshot, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return false;
+
+    bool written = fwrite(snapshot, 1, snapshot->size, file) == snapshot->size;
+    return fclose(file) == 0 && written;
+}
+
+/* Function responsible of reading a snapshot from a file into memory */
+Snapshot *loadSnapshot(const char *path) {
+    const Snapshot *mapped = mapSnapshot(path);
+    if (mapped == NULL) return NULL;
+
+    Snapshot *snapshot = forkSnapshot(mapped);
+    unmapSnapshot(mapped);
+    return snapshot;
+}
+
+/* Function responsible of mapping a snapshot file, pages are only read as the game is restored from it */
+const Snapshot *mapSnapshot(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Snapshot)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* The mapping stays valid once the descriptor is closed */
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    if (!checkSnapshot(data, info.st_size)) {
+        munmap(data, info.st_size);
+        return NULL;
+    }
+    return data;
+}
+
+/* Function responsible of unmapping a snapshot mapped with mapSnapshot */
+void unmapSnapshot(const Snapshot *snapshot) {
+    munmap((void *)snapshot, snapshot->size);
+}
+
+/* Function responsible of freeing a snapshot taken or loaded in memory */
+void freeSnapshot(Snapshot *snapshot) {
+    free(snapshot);
+}
+
+/* Function returning a number of bytes rounded up to whole 8-byte words */
+static size_t alignUp(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+/* Function responsible of filling in the header fields that only depend on the board size and the array lengths */
+static void layoutSnapshot(Snapshot *snapshot, int width, int height, unsigned int length, unsigned int food) {
+    size_t words = ((size_t)width * height + 63) / 64;
+    size_t blocks = (words + BOARD_BLOCK_WORDS - 1) / BOARD_BLOCK_WORDS;
+
+    memcpy(snapshot->magic, SNAPSHOT_MAGIC, 4);
+    snapshot->version = SNAPSHOT_VERSION;
+    snapshot->width = width;
+    snapshot->height = height;
+    snapshot->length = length;
+    snapshot->foodCount = food;
+    snapshot->bodyOffset = alignUp(sizeof(Snapshot));
+    snapshot->occupiedOffset = alignUp(snapshot->bodyOffset + (size_t)length * sizeof(Position));
+    snapshot->wallsOffset = snapshot->occupiedOffset + words * sizeof(uint64_t);
+    snapshot->blockFreeOffset = snapshot->wallsOffset + words * sizeof(uint64_t);
+    snapshot->foodOffset = alignUp(snapshot->blockFreeOffset + blocks * sizeof(uint16_t));
+    snapshot->size = snapshot->foodOffset + (size_t)food * sizeof(SnapshotFood);
+}
@@ -0,0 +1,61 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+
+/* Snapshot constants */
+#define SNAPSHOT_MAGIC   "SSNP"     /* first bytes of every snapshot */
+#define SNAPSHOT_VERSION 3          /* layout version, bumped whenever the layout or the engine changes */
+/* */
+
+/* Snapshot structure, a whole game in one flat block of memory.
+ * The arrays follow the header and are found through offsets from its start instead of pointers,
+ * so a snapshot can be copied, written to disk or mapped anywhere as is. Numbers are in the byte
+ * order of the machine that took it. Layout after the header, each array aligned to 8 bytes:
+ * the body (length positions, head first), the occupied bits, the wall bits, the free counts
+ * and the food items */
+typedef struct Snapshot {
+    char magic[4];
+    uint32_t version;
+    uint64_t size;                  /* bytes in the snapshot, header included */
+    int32_t width, height;
+    uint32_t direction;
+    uint32_t length;
+    uint32_t growth;
+    uint32_t speed;
+    int32_t appleX, appleY;
+    uint8_t isAlive, isWon, isPaused;
+    uint8_t wrap;                   /* LEVEL_WRAP_X and LEVEL_WRAP_Y, the sides of the board that wrap */
+    uint32_t freeCount;
+    uint64_t ticks;
+    uint64_t rng[4];
+    uint32_t foodTarget;            /* food items the game keeps on the board */
+    uint32_t foodCount;             /* food items saved */
+    uint64_t bodyOffset, occupiedOffset, wallsOffset, blockFreeOffset, foodOffset;
+} Snapshot;
+
+/* Food item as saved in a snapshot */
+typedef struct SnapshotFood {
+    int16_t pX, pY;
+    uint32_t kind;
+    uint64_t expires;
+} SnapshotFood;
+
+/* Function prototypes */
+size_t snapshotSize(int width, int height, unsigned int length, unsigned int food);
+Snapshot *takeSnapshot(const GameState *state);
+void captureGame(const GameState *state, Snapshot *snapshot);
+Snapshot *forkSnapshot(const Snapshot *snapshot);
+void restoreGame(GameState *state, const Snapshot *snapshot);
+GameState *startFromSnapshot(const Snapshot *snapshot);
+bool checkSnapshot(const Snapshot *snapshot, size_t size);
+bool saveSnapshot(const Snapshot *snapshot, const char *path);
+Snapshot *loadSnapshot(const char *path);
+const Snapshot *mapSnapshot(const char *path);
+void unmapSnapshot(const Snapshot *snapshot);
+void freeSnapshot(Snapshot *snapshot);
+/* */
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,149 @@
+/* 
+ * stats.c
+ *
+ * Copyright 2024 Darius Drake
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/* Libraries */
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "stats.h"
+/* */
+
+/* Global variables */
+bool statsEnabled = false;            /* phases are only timed when this is set */
+static Histogram histograms[PHASE_COUNT];
+static FILE *trace = NULL;            /* Chrome trace-event file, if one was asked for */
+static long long traceEpoch;          /* time of the first trace event */
+static bool traceFirst = true;        /* no event was written yet, so no comma is needed */
+/* */
+
+/* Names of the phases, as shown in the report and in the trace */
+static const char *phaseNames[PHASE_COUNT] = {
+    "input", "updateSnake", "updateApple", "drawGame", "refresh", "sleep", "keyToScreen"
+};
+/* */
+
+/* Histogram helpers */
+static inline unsigned int bucketOf(uint64_t value) {
+    if (value < 16) return value;
+
+    /* Keep the three bits after the leading one */
+    int exponent = 63 - __builtin_clzll(value);
+    return 16 + (exponent - 4) * 8 + ((value >> (exponent - 3)) & 7);
+}
+
+static inline uint64_t bucketValue(unsigned int bucket) {
+    if (bucket < 16) return bucket;
+
+    int exponent = (bucket - 16) / 8 + 4;
+    return (uint64_t)(8 + (bucket - 16) % 8) << (exponent - 3);
+}
+/* */
+
+/* Function responsible of turning on the timers, and the trace if a path is given */
+bool startStats(const char *tracePath) {
+    if (tracePath != NULL) {
+        trace = fopen(tracePath, "w");
+        if (trace == NULL) return false;
+        fprintf(trace, "{\"traceEvents\":[\n");
+    }
+
+    statsEnabled = true;
+    traceEpoch = statsClock();
+    return true;
+}
+
+/* Function returning the monotonic time in nanoseconds, or 0 when nothing is being measured */
+long long statsClock() {
+    if (!statsEnabled) return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Function responsible of recording a phase that started at the given time and ends now */
+void statsRecord(Phase phase, long long start) {
+    if (!statsEnabled) return;
+
+    long long end = statsClock();
+    uint64_t duration = end > start ? end - start : 0;
+
+    histogramAdd(&histograms[phase], duration);
+
+    /* Complete events, with times in microseconds as the trace format wants */
+    if (trace != NULL) {
+        fprintf(trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                traceFirst ? "" : ",\n", phaseNames[phase], (start - traceEpoch) / 1e3, duration / 1e3);
+        traceFirst = false;
+    }
+}
+
+/* Function responsible of printing a line per phase with its count and percentiles */
+void reportStats(FILE *out) {
+    fprintf(out, "%-12s %10s %10s %10s %10s %10s %10s\n", "phase", "count", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        const Histogram *histogram = &histograms[phase];
+        if (histogram->count == 0) continue;
+
+        fprintf(out, "%-12s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", phaseNames[phase],
+                (unsigned long long)histogram->count, (double)histogram->sum / histogram->count / 1e3,
+                histogramPercentile(histogram, 0.50) / 1e3, histogramPercentile(histogram, 0.90) / 1e3,
+                histogramPercentile(histogram, 0.99) / 1e3, histogram->max / 1e3);
+    }
+}
+
+/* Function responsible of closing the trace and turning off the timers */
+void stopStats() {
+    if (trace != NULL) {
+        fprintf(trace, "\n]}\n");
+        fclose(trace);
+        trace = NULL;
+    }
+
+    statsEnabled = false;
+}
+
+/* Function responsible of adding a value to a histogram */
+void histogramAdd(Histogram *histogram, uint64_t value) {
+    histogram->buckets[bucketOf(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max) histogram->max = value;
+}
+
+/* Function returning the smallest recorded value at or above the given fraction of the samples */
+uint64_t histogramPercentile(const Histogram *histogram, double p) {
+    uint64_t rank = (uint64_t)(p * (histogram->count - 1));
+    uint64_t seen = 0;
+
+    for (unsigned int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen > rank) {
+            /* Buckets only know a range, never report more than the real maximum */
+            uint64_t value = bucketValue(bucket);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
@@ -0,0 +1,45 @@
+#ifndef STATS_H
+#define STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Stats constants */
+#define STATS_BUCKETS    496        /* log-linear buckets: 16 exact ones, then 8 per power of two */
+/* */
+
+/* Phases of the game loop that are timed */
+typedef enum {
+    PHASE_INPUT,                    /* polling and handling the keyboard */
+    PHASE_SNAKE,                    /* moving the snake */
+    PHASE_APPLE,                    /* growing the snake and placing a new apple */
+    PHASE_DRAW,                     /* drawing the changed cells into the window */
+    PHASE_REFRESH,                  /* sending the frame to the terminal */
+    PHASE_SLEEP,                    /* waiting for the next deadline */
+    PHASE_LATENCY,                  /* from the key being read to its effect being on the screen */
+    PHASE_COUNT
+} Phase;
+
+/* Histogram of durations in nanoseconds, about 12% precision over the whole range */
+typedef struct Histogram {
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} Histogram;
+
+/* Global variables */
+extern bool statsEnabled;           /* phases are only timed when this is set */
+/* */
+
+/* Function prototypes */
+bool startStats(const char *tracePath);
+long long statsClock();
+void statsRecord(Phase phase, long long start);
+void reportStats(FILE *out);
+void stopStats();
+void histogramAdd(Histogram *histogram, uint64_t value);
+uint64_t histogramPercentile(const Histogram *histogram, double p);
+/* */
+
+#endif //STATS_H